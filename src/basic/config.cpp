@@ -219,7 +219,11 @@ Config::Config(int argc, const char **argv, bool check_io)
 		("in", 0, "input reference file in FASTA format", input_ref_file)
 		("taxonmap", 0, "protein accession to taxid mapping file", prot_accession2taxid)
 		("taxonnodes", 0, "taxonomy nodes.dmp from NCBI", nodesdmp)
-		("taxonnames", 0, "taxonomy names.dmp from NCBI", namesdmp);
+		("taxonnames", 0, "taxonomy names.dmp from NCBI", namesdmp)
+		("index", 0, "build a seed index for the sensitivity mode and block size given by the search options", seed_index)
+		("packed", 0, "store sequences with 5-bit packed residues (disables masking of the stored sequences)", packed_seqs)
+		("append", 0, "append the input sequences to an existing database", append_db)
+		("group-by-taxon", 0, "store sequences grouped by superkingdom so that taxonomy filtered searches skip unrelated ranges (requires --taxonmap and --taxonnodes)", group_by_taxon);
 
 	Options_group cluster("");
 	cluster.add()
@@ -276,11 +280,17 @@ Config::Config(int argc, const char **argv, bool check_io)
 
 	Options_group advanced("Advanced options");
 	advanced.add()
-		("algo", 0, "Seed search algorithm (0=double-indexed/1=query-indexed)", algo, -1)
+		("algo", 0, "Seed search algorithm (0=double-indexed/1=query-indexed/2=subject-indexed)", algo, -1)
 		("bin", 0, "number of query bins for seed search", query_bins)
 		("min-orf", 'l', "ignore translated sequences without an open reading frame of at least this length", run_len)
 		("freq-sd", 0, "number of standard deviations for ignoring frequent seeds", freq_sd, 0.0)
 		("id2", 0, "minimum number of identities for stage 1 hit", min_identities)
+		("trace-pt-membuf", 0, "memory in GB for keeping seed hits in memory instead of temporary files (default=0)", trace_pt_membuf)
+		("compress-temp", 0, "compression for temporary seed hit files (0=none, 1=delta encoding, 2=delta encoding+zlib)", compress_temp)
+		("fingerprint-width", 0, "width of the stage 1 seed fingerprint (32/48/64/auto, default=48; auto chooses by the lengths of the first query block)", fingerprint_width_str, string("48"))
+		("global-freq", 0, "mask frequent seeds by their frequency in the whole database, using a table stored next to the database (built on first use or by makedb)", global_freq)
+		("query-seed-set", 0, "file for saving the query seed set of the query-indexed algorithm and reusing it in later runs on the same queries", query_seed_set)
+		("minimizer-window", 0, "index only the window minimizers of the reference seeds (window size in seed positions, default=off)", minimizer_window)
 		("xdrop", 'x', "xdrop for ungapped alignment", ungapped_xdrop, 12.3)
 		("band", 0, "band for dynamic programming computation", padding)
 		("shapes", 's', "number of seed shapes (default=all available)", shapes)
@@ -299,6 +309,9 @@ Config::Config(int argc, const char **argv, bool check_io)
 		("stop-match-score", 0, "Set the match score of stop codons against each other.", stop_match_score, 1)
 		("tantan-minMaskProb", 0, "minimum repeat probability for masking (default=0.9)", tantan_minMaskProb, 0.9)
 		("file-buffer-size", 0, "file buffer size in bytes (default=67108864)", file_buffer_size, (size_t)67108864)
+		("no-mmap", 0, "read the database using buffered I/O instead of memory mapping", no_mmap)
+		("no-prefetch", 0, "do not load the next reference block while aligning the current one", no_prefetch)
+		("no-block-cache", 0, "do not keep reference blocks in memory across query chunks", no_block_cache)
 		("memory-limit", 'M', "Memory limit for extension stage in GB", memory_limit);
 
 	Options_group view_options("View options");
@@ -369,7 +382,7 @@ Config::Config(int argc, const char **argv, bool check_io)
 		("transcript-len-estimate", 0, "", transcript_len_estimate, 1.0)
 		("family-counts", 0, "", family_counts_file)
 		("radix-cluster-buffered", 0, "", radix_cluster_buffered)
-		("join-split-size", 0, "", join_split_size, 100000u)
+		("join-split-size", 0, "", join_split_size)
 		("join-split-key-len", 0, "", join_split_key_len, 17u)
 		("radix-bits", 0, "", radix_bits, 8u)
 		("join-ht-factor", 0, "", join_ht_factor, 1.3)
@@ -490,7 +503,7 @@ Config::Config(int argc, const char **argv, bool check_io)
 		case Config::makedb:
 			if (database == "")
 				throw std::runtime_error("Missing parameter: database file (--db/-d)");
-			if (chunk_size != 0.0)
+			if (chunk_size != 0.0 && !seed_index)
 				throw std::runtime_error("Invalid option: --block-size/-b. Block size is set for the alignment commands.");
 			break;
 		case Config::blastp:
@@ -510,6 +523,10 @@ Config::Config(int argc, const char **argv, bool check_io)
 				if (!no_auto_append)
 					auto_append_extension(output_file, ".daa");
 			}
+			if (compress_temp > 2)
+				throw std::runtime_error("Invalid value for --compress-temp (0/1/2).");
+			if (minimizer_window > 1 && hashed_seeds)
+				throw std::runtime_error("Option --minimizer-window is not supported with hashed seeds.");
 			break;
 		case Config::view:
 			if (daa_file == "")
@@ -579,6 +596,8 @@ Config::Config(int argc, const char **argv, bool check_io)
 	verbose_stream << "Assertions enabled." << endl;
 #endif
 	set_option(threads_, std::thread::hardware_concurrency());
+	// Hash join partitions are split until their hash table (about 32 bytes per build side entry) fits into L2.
+	set_option(join_split_size, (unsigned)(l2_cache_size() / 32));
 
 	switch (command) {
 	case Config::makedb:
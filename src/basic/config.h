@@ -52,6 +52,9 @@ struct Config
 	double	chunk_size;
 	unsigned min_identities;
 	unsigned min_identities2;
+	string fingerprint_width_str;
+	unsigned fingerprint_width;
+	unsigned minimizer_window;
 	double ungapped_xdrop;
 	int		raw_ungapped_xdrop;
 	unsigned	min_compressed_identities;
@@ -211,6 +214,7 @@ struct Config
 	size_t file_buffer_size;
 	bool self;
 	size_t trace_pt_fetch_size;
+	double trace_pt_membuf;
 	uint32_t tile_size;
 	double short_query_ungapped_bitscore;
 	int short_query_max_len;
@@ -242,6 +246,15 @@ struct Config
 	bool forward_fp;
 	bool no_ref_masking;
 	string roc_file;
+	bool seed_index;
+	bool global_freq;
+	string query_seed_set;
+	bool no_mmap;
+	bool packed_seqs;
+	bool no_prefetch;
+	bool no_block_cache;
+	bool append_db;
+	bool group_by_taxon;
 
 	Sensitivity sensitivity;
 	TracebackMode traceback_mode;
@@ -17,11 +17,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
 #include <math.h>
+#include <string.h>
 #include <algorithm>
 #include <atomic>
 #include "masking.h"
 #include "../lib/tantan/LambdaCalculator.hh"
 #include "../util/tantan.h"
+#include "../util/algo/MurmurHash3.h"
 
 using namespace std;
 
@@ -77,6 +79,20 @@ void Masking::remove_bit_mask(Letter *seq, size_t len) const
 			seq[i] &= ~bit_mask;
 }
 
+uint64_t Masking::parameter_id() const
+{
+	const unsigned n = value_traits.alphabet_size;
+	vector<float> v;
+	for (unsigned i = 0; i < n; ++i)
+		v.insert(v.end(), likelihoodRatioMatrixf_[i], likelihoodRatioMatrixf_[i] + n);
+	v.push_back((float)config.tantan_minMaskProb);
+	char seed[16] = {}, h[16];
+	MurmurHash3_x64_128(v.data(), int(v.size() * sizeof(float)), seed, h);
+	uint64_t id;
+	memcpy(&id, h, sizeof(id));
+	return id == 0 ? 1 : id;
+}
+
 void mask_worker(atomic<size_t> *next, Sequence_set *seqs, const Masking *masking, bool hard_mask)
 {
 	size_t i;
@@ -30,6 +30,8 @@ struct Masking
 	void mask_bit(Letter *seq, size_t len) const;
 	void bit_to_hard_mask(Letter *seq, size_t len, size_t &n) const;
 	void remove_bit_mask(Letter *seq, size_t len) const;
+	// Identifies the masking parameters, nonzero.
+	uint64_t parameter_id() const;
 	static const Masking& get()
 	{
 		return *instance;
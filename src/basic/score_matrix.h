@@ -83,6 +83,15 @@ struct Score_matrix
 		return matrix8_.data[(int(a) << 5) + int(b)];
 	}
 
+	bool symmetric() const
+	{
+		for (int i = 0; i < 32; ++i)
+			for (int j = 0; j < i; ++j)
+				if (matrix8_.data[(i << 5) + j] != matrix8_.data[(j << 5) + i])
+					return false;
+		return true;
+	}
+
 	const int* row(Letter a) const
 	{
 		return &matrix32_.data[(int)a << 5];
@@ -0,0 +1,108 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <string.h>
+#include "seed_iterator.h"
+
+namespace DISPATCH_ARCH {
+
+// The vector kernels compute the key as hi * size^(weight - h) + lo, where hi and lo are the keys of the first h and
+// the remaining shape positions. Both need to fit into 32 bit lanes.
+static bool split_key(const Shape &sh, unsigned &h, uint32_t &factor)
+{
+	const uint64_t size = Reduction::reduction.size();
+	h = sh.weight_ / 2;
+	uint64_t hi_max = 1, lo_max = 1;
+	for (unsigned i = 0; i < h; ++i)
+		hi_max *= size;
+	for (unsigned i = h; i < sh.weight_; ++i)
+		lo_max *= size;
+	factor = (uint32_t)lo_max;
+	return hi_max <= UINT32_MAX && lo_max <= UINT32_MAX;
+}
+
+#ifdef __AVX2__
+
+// Keys of 8 consecutive positions.
+static inline void seed_keys8(const Letter *seq, const Shape &sh, unsigned h, const __m256i &factor, uint64_t *keys)
+{
+	const __m256i size = _mm256_set1_epi32(Reduction::reduction.size()), mask = _mm256_set1_epi32(value_traits.mask_char);
+	__m256i hi = _mm256_setzero_si256(), lo = _mm256_setzero_si256(), invalid = _mm256_setzero_si256();
+	for (unsigned i = 0; i < sh.weight_; ++i) {
+		const __m256i l = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(seq + sh.positions_[i])));
+		invalid = _mm256_or_si256(invalid, _mm256_cmpeq_epi32(l, mask));
+		if (i < h)
+			hi = _mm256_add_epi32(_mm256_mullo_epi32(hi, size), l);
+		else
+			lo = _mm256_add_epi32(_mm256_mullo_epi32(lo, size), l);
+	}
+	const __m256i k0 = _mm256_add_epi64(_mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(hi)), factor), _mm256_cvtepu32_epi64(_mm256_castsi256_si128(lo))),
+		k1 = _mm256_add_epi64(_mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(hi, 1)), factor), _mm256_cvtepu32_epi64(_mm256_extracti128_si256(lo, 1)));
+	_mm256_storeu_si256((__m256i*)keys, _mm256_or_si256(k0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(invalid))));
+	_mm256_storeu_si256((__m256i*)(keys + 4), _mm256_or_si256(k1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(invalid, 1))));
+}
+
+#elif defined(__SSE4_1__)
+
+// Keys of 4 consecutive positions.
+static inline void seed_keys4(const Letter *seq, const Shape &sh, unsigned h, const __m128i &factor, uint64_t *keys)
+{
+	const __m128i size = _mm_set1_epi32(Reduction::reduction.size()), mask = _mm_set1_epi32(value_traits.mask_char);
+	__m128i hi = _mm_setzero_si128(), lo = _mm_setzero_si128(), invalid = _mm_setzero_si128();
+	for (unsigned i = 0; i < sh.weight_; ++i) {
+		int32_t x;
+		memcpy(&x, seq + sh.positions_[i], 4);
+		const __m128i l = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(x));
+		invalid = _mm_or_si128(invalid, _mm_cmpeq_epi32(l, mask));
+		if (i < h)
+			hi = _mm_add_epi32(_mm_mullo_epi32(hi, size), l);
+		else
+			lo = _mm_add_epi32(_mm_mullo_epi32(lo, size), l);
+	}
+	const __m128i k0 = _mm_add_epi64(_mm_mul_epu32(_mm_cvtepu32_epi64(hi), factor), _mm_cvtepu32_epi64(lo)),
+		k1 = _mm_add_epi64(_mm_mul_epu32(_mm_cvtepu32_epi64(_mm_srli_si128(hi, 8)), factor), _mm_cvtepu32_epi64(_mm_srli_si128(lo, 8)));
+	_mm_storeu_si128((__m128i*)keys, _mm_or_si128(k0, _mm_cvtepi32_epi64(invalid)));
+	_mm_storeu_si128((__m128i*)(keys + 2), _mm_or_si128(k1, _mm_cvtepi32_epi64(_mm_srli_si128(invalid, 8))));
+}
+
+#endif
+
+void reduced_seed_keys(const Letter *seq, size_t n, const Shape &sh, uint64_t *keys)
+{
+	size_t i = 0;
+	unsigned h;
+	uint32_t factor;
+	if (split_key(sh, h, factor)) {
+#ifdef __AVX2__
+		const __m256i f = _mm256_set1_epi64x(factor);
+		for (; i + 8 <= n; i += 8)
+			seed_keys8(seq + i, sh, h, f, keys + i);
+#elif defined(__SSE4_1__)
+		const __m128i f = _mm_set1_epi64x(factor);
+		for (; i + 4 <= n; i += 4)
+			seed_keys4(seq + i, sh, h, f, keys + i);
+#endif
+	}
+	for (; i < n; ++i)
+		if (!sh.set_seed_reduced(keys[i], seq + i))
+			keys[i] = INVALID_SEED_KEY;
+}
+
+}
@@ -22,24 +22,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "shape.h"
 #include "sequence.h"
 #include "../util/hash_function.h"
+#include "../util/simd.h"
 
-struct Seed_iterator
+// Marks positions where the shape covers a masked letter.
+static const uint64_t INVALID_SEED_KEY = UINT64_MAX;
+
+// Computes the reduced seed keys of the positions [0, n) of seq. Positions that cannot form a seed are set to
+// INVALID_SEED_KEY.
+DECL_DISPATCH(void, reduced_seed_keys, (const Letter *seq, size_t n, const Shape &sh, uint64_t *keys))
+
+// Selects the window minimizers among the seed keys of positions [0, n), i.e. in each window of w consecutive
+// positions the valid key of lowest hash value (leftmost on ties). A sequence shorter than w forms a single window.
+// The hash values and the queue need room for n entries. Returns the number of distinct minimizer positions written
+// to out.
+inline size_t window_minimizers(const uint64_t *keys, size_t n, size_t w, uint64_t *hashes, uint32_t *queue, uint32_t *out)
 {
-	Seed_iterator(vector<Letter> &seq, const Shape &sh):
-		ptr_ (seq.data()),
-		end_ (ptr_ + seq.size() - sh.length_ + 1)
-	{}
-	bool good() const
-	{
-		return ptr_ < end_;
+	size_t head = 0, tail = 0, m = 0;
+	for (size_t j = 0; j < n; ++j) {
+		if (keys[j] != INVALID_SEED_KEY) {
+			hashes[j] = murmur_hash()(keys[j]);
+			while (tail > head && hashes[queue[tail - 1]] > hashes[j])
+				--tail;
+			queue[tail++] = (uint32_t)j;
+		}
+		if (j + 1 < w && j + 1 < n)
+			continue;
+		while (tail > head && queue[head] + w <= j)
+			++head;
+		if (tail > head && (m == 0 || out[m - 1] != queue[head]))
+			out[m++] = queue[head];
 	}
-	bool get(uint64_t &seed, const Shape &sh)
-	{
-		return sh.set_seed_reduced(seed, ptr_++);
-	}
-private:
-	const Letter *ptr_, *end_;
-};
+	return m;
+}
 
 template<uint64_t _b>
 struct Hashed_seed_iterator
@@ -21,27 +21,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <numeric>
 #include <utility>
-#include <atomic>
 #include "frequent_seeds.h"
 #include "queries.h"
+#include "reference.h"
+#include "seed_frequency.h"
 #include "../util/parallel/thread_pool.h"
 
-using std::atomic;
-
 const double Frequent_seeds::hash_table_factor = 1.3;
 Frequent_seeds frequent_seeds;
 
-void Frequent_seeds::compute_sd(atomic<unsigned> *seedp, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, vector<Sd> *ref_out, vector<Sd> *query_out)
+void Frequent_seeds::partition_sd(DoubleArray<SeedArray::_pos> &query_seed_hits, DoubleArray<SeedArray::_pos> &ref_seed_hits, Sd &query_sd, Sd &ref_sd)
 {
-	unsigned p;
-	while ((p = (*seedp)++) < current_range.end()) {
-		Sd ref_sd, query_sd;
-		for (auto it = JoinIterator<SeedArray::_pos>(query_seed_hits[p].begin(), ref_seed_hits[p].begin()); it; ++it) {
-			query_sd.add((double)it.r->size());
-			ref_sd.add((double)it.s->size());
-		}
-		(*ref_out)[p - current_range.begin()] = ref_sd;
-		(*query_out)[p - current_range.begin()] = query_sd;
+	for (auto it = JoinIterator<SeedArray::_pos>(query_seed_hits.begin(), ref_seed_hits.begin()); it; ++it) {
+		query_sd.add((double)it.r->size());
+		ref_sd.add((double)it.s->size());
 	}
 }
 
@@ -60,8 +53,17 @@ void Frequent_seeds::build_worker(
 
 	vector<uint32_t> buf;
 	size_t n = 0;
+	const SeedFrequency *global = SeedFrequency::instance;
+	const unsigned global_cap = global ? global->cap(sid) : 0;
 	for (auto it = JoinIterator<SeedArray::_pos>(query_seed_hits[seedp].begin(), ref_seed_hits[seedp].begin()); it;) {
-		if (it.s->size() > ref_max_n || it.r->size() > query_max_n) {
+		bool frequent = it.r->size() > query_max_n;
+		if (global) {
+			Packed_seed seed;
+			frequent = frequent || (shapes[sid].set_seed(seed, ref_seqs::data_->data(*it.s->begin())) && global->count(seed, sid) > global_cap);
+		}
+		else
+			frequent = frequent || it.s->size() > ref_max_n;
+		if (frequent) {
 			n += (unsigned)it.s->size();
 			//Packed_seed s;
 			//shapes[sid].set_seed(s, query_seqs::get().data(*it.r->begin()));
@@ -90,21 +92,16 @@ void Frequent_seeds::build_worker(
 	(*counts)[seedp] = (unsigned)n;
 }
 
-void Frequent_seeds::build(unsigned sid, const SeedPartitionRange &range, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits)
+void Frequent_seeds::build(unsigned sid, const SeedPartitionRange &range, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, const vector<Sd> &query_sds, const vector<Sd> &ref_sds)
 {
-	vector<Sd> ref_sds(range.size()), query_sds(range.size());
-	atomic<unsigned> seedp(range.begin());
-	vector<std::thread> threads;
-	for (unsigned i = 0; i < config.threads_; ++i)
-		threads.emplace_back(compute_sd, &seedp, query_seed_hits, ref_seed_hits, &ref_sds, &query_sds);
-	for (auto &t : threads)
-		t.join();
-
 	Sd ref_sd(ref_sds), query_sd(query_sds);
 	const unsigned ref_max_n = (unsigned)(ref_sd.mean() + config.freq_sd*ref_sd.sd()), query_max_n = (unsigned)(query_sd.mean() + config.freq_sd*query_sd.sd());
 	log_stream << "Seed frequency mean (reference) = " << ref_sd.mean() << ", SD = " << ref_sd.sd() << endl;
 	log_stream << "Seed frequency mean (query) = " << query_sd.mean() << ", SD = " << query_sd.sd() << endl;
-	log_stream << "Seed frequency cap query: " << query_max_n << ", reference: " << ref_max_n << endl;
+	if (SeedFrequency::instance)
+		log_stream << "Seed frequency cap query: " << query_max_n << ", database: " << SeedFrequency::instance->cap(sid) << endl;
+	else
+		log_stream << "Seed frequency cap query: " << query_max_n << ", reference: " << ref_max_n << endl;
 	vector<unsigned> counts(Const::seedp);
 	Util::Parallel::scheduled_thread_pool_auto(config.threads_, Const::seedp, build_worker, query_seed_hits, ref_seed_hits, &range, sid, ref_max_n, query_max_n, &counts);
 	log_stream << "Masked positions = " << std::accumulate(counts.begin(), counts.end(), 0) << std::endl;
@@ -24,20 +24,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../basic/const.h"
 #include "../util/hash_table.h"
 #include "seed_array.h"
+#include "seed_frequency.h"
 #include "../util/algo/join_result.h"
 #include "../util/range.h"
 
 struct Frequent_seeds
 {
 
-	void build(unsigned sid, const SeedPartitionRange &range, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits);
+	// Masks the frequent seeds of the range, given the per partition seed frequency statistics of partition_sd.
+	void build(unsigned sid, const SeedPartitionRange &range, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, const vector<Sd> &query_sds, const vector<Sd> &ref_sds);
+	static void partition_sd(DoubleArray<SeedArray::_pos> &query_seed_hits, DoubleArray<SeedArray::_pos> &ref_seed_hits, Sd &query_sd, Sd &ref_sd);
 
 	bool get(const Letter *pos, unsigned sid) const
 	{
 		Packed_seed seed;
-		const bool t = config.algo == Config::double_indexed ? shapes[sid].set_seed(seed, pos) : shapes[sid].set_seed_shifted(seed, pos);
+		const bool t = config.algo != Config::query_indexed ? shapes[sid].set_seed(seed, pos) : shapes[sid].set_seed_shifted(seed, pos);
 		if (!t)
 			return true;
+		if (SeedFrequency::instance)
+			return SeedFrequency::instance->frequent(seed, sid);
 		return tables_[sid][seed_partition(seed)].contains(seed_partition_offset(seed));
 	}
 
@@ -58,8 +63,6 @@ private:
 		unsigned query_max_n,
 		vector<unsigned> *counts);
 
-	static void compute_sd(std::atomic<unsigned> *seedp, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, vector<Sd> *ref_out, vector<Sd> *query_out);
-
 	PHash_set<void,murmur_hash> tables_[Const::max_shapes][Const::seedp];
 
 };
@@ -26,7 +26,6 @@ unsigned current_query_chunk;
 Sequence_set* query_source_seqs::data_ = 0;
 Sequence_set* query_seqs::data_ = 0;
 String_set<char, '\0'>* query_ids::data_ = 0;
-Partitioned_histogram query_hst;
 vector<bool> query_aligned;
 std::mutex query_aligned_mtx;
 Seed_set *query_seeds = 0;
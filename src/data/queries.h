@@ -27,7 +27,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "seed_histogram.h"
 #include "../util/io/output_file.h"
 
-extern Partitioned_histogram query_hst;
 extern unsigned current_query_chunk;
 
 struct query_source_seqs
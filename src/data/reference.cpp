@@ -28,6 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include <algorithm>
 #include <cmath>
+#include <future>
 #include "../basic/config.h"
 #include "reference.h"
 #include "load_seqs.h"
@@ -42,6 +43,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../util/algo/MurmurHash3.h"
 #include "../util/io/record_reader.h"
 #include "../util/parallel/multiprocessing.h"
+#include "seed_index.h"
+#include "seed_frequency.h"
+#include "../util/sequence/packed.h"
+#include "../util/system/system.h"
 
 String_set<char, '\0'>* ref_ids::data_ = nullptr;
 Partitioned_histogram ref_hst;
@@ -57,7 +62,7 @@ Serializer& operator<<(Serializer &s, const ReferenceHeader2 &h)
 	s.unset(Serializer::VARINT);
 	s << sizeof(ReferenceHeader2);
 	s.write(h.hash, sizeof(h.hash));
-	s << h.taxon_array_offset << h.taxon_array_size << h.taxon_nodes_offset << h.taxon_names_offset;
+	s << h.taxon_array_offset << h.taxon_array_size << h.taxon_nodes_offset << h.taxon_names_offset << h.id_array_offset << h.seq_section_offset << h.seq_encoding << h.masking_id << h.taxon_ranges_offset;
 	return s;
 }
 
@@ -68,6 +73,11 @@ Deserializer& operator>>(Deserializer &d, ReferenceHeader2 &h)
 		>> h.taxon_array_size
 		>> h.taxon_nodes_offset
 		>> h.taxon_names_offset
+		>> h.id_array_offset
+		>> h.seq_section_offset
+		>> h.seq_encoding
+		>> h.masking_id
+		>> h.taxon_ranges_offset
 		>> Finish();
 	return d;
 }
@@ -120,24 +130,56 @@ void DatabaseFile::init()
 	if (ref_header.sequences == 0)
 		throw std::runtime_error("Incomplete database file. Database building did not complete successfully.");
 	*this >> header2;
+	if (header2.seq_encoding > ReferenceHeader2::PACKED_ENCODING)
+		throw std::runtime_error("Database was built with a newer version of Diamond and is incompatible.");
+	packed_ = header2.seq_encoding == ReferenceHeader2::PACKED_ENCODING;
 	pos_array_offset = ref_header.pos_array_offset;
 }
 
 DatabaseFile::DatabaseFile(const string &input_file):
 	InputFile(input_file, InputFile::BUFFERED),
-	temporary(false)
+	temporary(false),
+	apply_stored_masks(false),
+	map_seqs(false),
+	packed_(false),
+	seq_read_pos_(0),
+	id_read_pos_(0),
+	seq_read_count_(0),
+	mapped_file_(nullptr)
 {
 	init();
+	if (!config.no_mmap) {
+		try {
+			mapped_file_ = new MappedFile(input_file);
+		}
+		catch (std::runtime_error &e) {
+			verbose_stream << "Database file could not be memory mapped (" << e.what() << "), using buffered reads." << endl;
+		}
+	}
 }
 
 DatabaseFile::DatabaseFile(TempFile &tmp_file):
 	InputFile(tmp_file, 0),
-	temporary(true)
+	temporary(true),
+	apply_stored_masks(false),
+	map_seqs(false),
+	packed_(false),
+	seq_read_pos_(0),
+	id_read_pos_(0),
+	seq_read_count_(0),
+	mapped_file_(nullptr)
 {
 	init();
 }
 
+DatabaseFile::~DatabaseFile()
+{
+	delete mapped_file_;
+}
+
 void DatabaseFile::close() {
+	delete mapped_file_;
+	mapped_file_ = nullptr;
 	if (temporary)
 		InputFile::close_and_delete();
 	else
@@ -176,16 +218,124 @@ size_t DatabaseFile::total_blocks() const {
 	return (this->ref_header.letters + c - 1) / c;
 }
 
-void push_seq(const sequence &seq, const char *id, size_t id_len, uint64_t &offset, vector<Pos_record> &pos_array, OutputFile &out, size_t &letters, size_t &n_seqs)
+static const char SEQ_DELIMITER = sequence::DELIMITER;
+
+// Returns true if the n bytes at p are all letters or delimiters, so that they can serve as the padding of a sequence set.
+static bool letters_only(const char *p, size_t n)
+{
+	for (const char *end = p + n; p < end; ++p)
+		if ((size_t)(uint8_t)*p >= AMINO_ACID_COUNT && *p != SEQ_DELIMITER)
+			return false;
+	return true;
+}
+
+// Adds the 128 bit hash h to the database hash. The sum does not depend on the order of the sequences, so that the hash
+// of a database built with appends is the same as for a database built from all sequences at once.
+static void add_hash(char *dst, const char *h)
 {
-	pos_array.emplace_back(offset, seq.length());
-	out.write("\xff", 1);
-	out.write(seq.data(), seq.length());
-	out.write("\xff", 1);
-	out.write(id, id_len + 1);
-	letters += seq.length();
-	++n_seqs;
-	offset += seq.length() + id_len + 3;
+	uint64_t a[2], b[2];
+	memcpy(a, dst, sizeof(a));
+	memcpy(b, h, sizeof(b));
+	a[0] += b[0];
+	a[1] += b[1];
+	memcpy(dst, a, sizeof(a));
+}
+
+// An existing database that sequences are appended to. The appended database is written to a new file: the existing
+// one is copied up to the end of its sequence section, followed by the new sequences, and the sections following it
+// (ids, trailer, taxonomy) are merged from the existing file. The new file replaces the database once it is complete,
+// so a failed append leaves the existing database unchanged.
+struct AppendSource
+{
+
+	AppendSource(const string &file_name):
+		tail(file_name, InputFile::BUFFERED)
+	{
+		task_timer timer("Opening the database for appending");
+		DatabaseFile db(file_name);
+		if (db.ref_header.db_version < DatabaseFile::SUM_HASH_DB_VERSION)
+			throw std::runtime_error("Appending requires a database of format version " + to_string(DatabaseFile::SUM_HASH_DB_VERSION) + ". Please rebuild the database.");
+		if (db.header2.seq_encoding != ReferenceHeader2::BYTE_ENCODING)
+			throw std::runtime_error("Appending to databases with packed sequences is not supported.");
+		header = db.ref_header;
+		header2 = db.header2;
+		taxon_ranges = db.taxon_ranges();
+		db.seek(header2.id_array_offset);
+		db >> id_section_offset;
+		// The final position record points to the delimiter after the last sequence, which may be followed by padding.
+		Pos_record r;
+		db.seek(header.pos_array_offset + header.sequences * Pos_record::SIZE);
+		db >> r;
+		seq_section_end = r.pos;
+		id_section_size = header.pos_array_offset - id_section_offset;
+		db.close();
+		tail.varint = false;
+
+		const uint64_t sections[] = { header2.taxon_array_offset, header2.taxon_nodes_offset, header2.taxon_names_offset, header2.taxon_ranges_offset, (uint64_t)file_size(file_name.c_str()) };
+		nodes_size = section_size(header2.taxon_nodes_offset, sections);
+		names_size = section_size(header2.taxon_names_offset, sections);
+	}
+
+	// Copies the headers and the sequences of the existing database to out, except for the final delimiter, which
+	// becomes the leading delimiter of the first appended sequence, and the padding. The remaining sections are read
+	// from the id section on.
+	void copy_sequences(Serializer *out)
+	{
+		copy(out, seq_section_end);
+		tail.seek(id_section_offset);
+	}
+
+	// Copies the next n bytes of the existing database to out, or skips them if out is nullptr.
+	void copy(Serializer *out, uint64_t n)
+	{
+		vector<char> buf(1 << 20);
+		while (n > 0) {
+			const size_t m = (size_t)std::min(n, (uint64_t)buf.size());
+			if (tail.read(buf.data(), m) != m)
+				throw std::runtime_error("Unexpected end of database file.");
+			if (out)
+				out->write(buf.data(), m);
+			n -= m;
+		}
+	}
+
+	ReferenceHeader header;
+	ReferenceHeader2 header2;
+	uint64_t seq_section_end, id_section_offset, id_section_size, nodes_size, names_size;
+	vector<TaxonRange> taxon_ranges;
+	InputFile tail;
+
+private:
+
+	static uint64_t section_size(uint64_t offset, const uint64_t *sections)
+	{
+		if (offset == 0)
+			return 0;
+		uint64_t end = sections[4];
+		for (int i = 0; i < 4; ++i)
+			if (sections[i] > offset)
+				end = std::min(end, sections[i]);
+		return end - offset;
+	}
+
+};
+
+// Returns the superkingdom shared by all taxa the accessions are mapped to, 0 if there is none or several.
+static unsigned top_level_taxon(const vector<string> &accessions, const TaxonomyNodes &nodes)
+{
+	set<unsigned> top;
+	for (const string &a : accessions) {
+		unsigned taxid;
+		try {
+			taxid = taxonomy.get(Taxonomy::Accession(a.c_str()));
+		}
+		catch (AccessionLengthError &) {
+			continue;
+		}
+		if (taxid != 0)
+			top.insert(nodes.rank_taxid(taxid, Rank::superkingdom));
+	}
+	return top.size() == 1 ? *top.begin() : 0;
 }
 
 void make_db(TempFile **tmp_out, TextInputFile *input_file)
@@ -202,79 +352,290 @@ void make_db(TempFile **tmp_out, TextInputFile *input_file)
 	task_timer timer("Opening the database file", true);
 	TextInputFile *db_file = input_file ? input_file : new TextInputFile(input_file_name);
 
-	OutputFile *out = tmp_out ? new TempFile() : new OutputFile(config.database);
+	unique_ptr<AppendSource> base(config.append_db && !tmp_out ? new AppendSource(config.database) : nullptr);
+	if (base && config.packed_seqs)
+		throw std::runtime_error("Appending to databases with packed sequences is not supported.");
+	if (config.group_by_taxon && (config.prot_accession2taxid.empty() || config.nodesdmp.empty()))
+		throw std::runtime_error("Option --group-by-taxon requires the options --taxonmap and --taxonnodes.");
+	if (config.group_by_taxon && base)
+		throw std::runtime_error("Option --group-by-taxon cannot be used with --append.");
+	// Appended sequences are masked like the existing ones.
+	const bool mask = base ? base->header2.masking_id != 0 : config.masking == 1 && !config.packed_seqs;
+	if (base && mask && (!Masking::instance || Masking::get().parameter_id() != base->header2.masking_id))
+		throw std::runtime_error("The database was masked with different parameters. Please use the masking options of the existing database.");
+
+	const string out_file_name = base ? config.database + ".tmp" : config.database;
+	OutputFile *out = tmp_out ? new TempFile() : new OutputFile(out_file_name);
+	// Removes the output file if building the database fails.
+	struct RemoveOnError {
+		~RemoveOnError()
+		{
+			if (!out)
+				return;
+			try {
+				out->close();
+			}
+			catch (std::exception&) {}
+			out->remove();
+		}
+		OutputFile *out;
+	} remove_on_error{ tmp_out ? nullptr : out };
 	ReferenceHeader header;
 	ReferenceHeader2 header2;
 
-	*out << header;
-	*out << header2;
+	if (base) {
+		memcpy(header2.hash, base->header2.hash, sizeof(header2.hash));
+		header2.seq_section_offset = base->header2.seq_section_offset;
+		header2.masking_id = base->header2.masking_id;
+		timer.go("Copying the existing sequences");
+		base->copy_sequences(out);
+	}
+	else {
+		*out << header;
+		*out << header2;
+		// Byte encoded blocks are used in place of a memory mapping, which needs the perimeter padding of the sequence
+		// set in front of the first and after the last sequence.
+		if (!config.packed_seqs) {
+			const string padding(Sequence_set::PERIMETER_PADDING, SEQ_DELIMITER);
+			out->write(padding.data(), padding.length());
+		}
+		header2.seq_section_offset = out->tell();
+	}
 
-	size_t letters = 0, n = 0, n_seqs = 0;
-	uint64_t offset = out->tell();
+	size_t letters = 0, n_seqs = 0;
+	if (config.packed_seqs)
+		header2.seq_encoding = ReferenceHeader2::PACKED_ENCODING;
+	Util::Sequence::PackedWriter packer(*out);
+	uint64_t offset = config.packed_seqs ? 0 : (base ? base->seq_section_end : header2.seq_section_offset),
+		id_offset = base ? base->id_section_size : 0;
 
-	Sequence_set *seqs;
-	String_set<char, 0> *ids;
 	const FASTA_format format;
 	vector<Pos_record> pos_array;
-	FileBackedBuffer accessions;
+	vector<uint64_t> id_array;
+	FileBackedBuffer accessions, id_buffer;
+
+	// With --group-by-taxon, sequences are buffered per superkingdom and written as one range per group
+	// once the input has been read. Unclassified sequences form the last range.
+	struct TaxonGroup {
+		FileBackedBuffer seqs, accessions;
+		size_t n = 0;
+	};
+	map<unsigned, unique_ptr<TaxonGroup>> groups;
+	vector<TaxonRange> taxon_ranges = base ? base->taxon_ranges : vector<TaxonRange>();
+
+	auto push_seq = [&](const sequence &seq, const char *id, size_t id_len) {
+		pos_array.emplace_back(offset, seq.length());
+		if (config.packed_seqs) {
+			packer.push(DELIMITER_LETTER);
+			packer.push(seq.data(), seq.data() + seq.length());
+		}
+		else {
+			out->write(&SEQ_DELIMITER, 1);
+			out->write(seq.data(), seq.length());
+		}
+		id_array.push_back(id_offset);
+		id_buffer.write(id, id_len + 1);
+		letters += seq.length();
+		++n_seqs;
+		offset += seq.length() + 1;
+		id_offset += id_len + 1;
+	};
 
-	try {
-		while ((timer.go("Loading sequences"), n = load_seqs(*db_file, format, &seqs, ids, 0, nullptr, (size_t)(1e9), string(), amino_acid_traits)) > 0) {
-			if (config.masking == 1) {
-				timer.go("Masking sequences");
-				mask_seqs(*seqs, Masking::get(), false);
-			}
-			timer.go("Writing sequences");
+	struct Batch {
+		Sequence_set *seqs;
+		String_set<char, 0> *ids;
+		size_t n;
+	};
+
+	auto load_batch = [db_file, &format]() {
+		Batch b;
+		b.n = load_seqs(*db_file, format, &b.seqs, b.ids, 0, nullptr, (size_t)(1e9), string(), amino_acid_traits);
+		for (size_t i = 0; i < b.n; ++i)
+			if (b.seqs->length(i) == 0)
+				throw std::runtime_error("File format error: sequence of length 0 at line " + to_string(db_file->line_count));
+		return b;
+	};
+
+	taxonomy.init();
+	unique_ptr<TaxonomyNodes> nodes(config.group_by_taxon ? new TaxonomyNodes(taxonomy) : nullptr);
+
+	// The next batch is parsed while the current one is masked, written and hashed. Hashing runs
+	// concurrently with writing.
+	timer.go("Loading sequences");
+	std::future<Batch> next = std::async(std::launch::async, load_batch);
+	Batch batch;
+	while ((batch = next.get()).n > 0) {
+		const size_t n = batch.n;
+		const Sequence_set *seqs = batch.seqs;
+		const String_set<char, 0> *ids = batch.ids;
+		next = std::async(std::launch::async, load_batch);
+		if (mask) {
+			header2.masking_id = Masking::get().parameter_id();
+			timer.go("Masking sequences");
+			mask_seqs(*batch.seqs, Masking::get(), false);
+		}
+		timer.go("Writing sequences");
+		std::future<void> hash = std::async(std::launch::async, [seqs, ids, n, &header2]() {
 			for (size_t i = 0; i < n; ++i) {
 				sequence seq = (*seqs)[i];
-				if (seq.length() == 0)
-					throw std::runtime_error("File format error: sequence of length 0 at line " + to_string(db_file->line_count));
-				push_seq(seq, (*ids)[i], ids->length(i), offset, pos_array, *out, letters, n_seqs);
+				char h[16] = {};
+				MurmurHash3_x64_128(seq.data(), (int)seq.length(), h, h);
+				MurmurHash3_x64_128((*ids)[i], ids->length(i), h, h);
+				add_hash(header2.hash, h);
 			}
-			if (!config.prot_accession2taxid.empty()) {
-				timer.go("Writing accessions");
-				for (size_t i = 0; i < n; ++i)
-					accessions << Taxonomy::Accession::from_title((*ids)[i]);
-			}
-			timer.go("Hashing sequences");
+		});
+		if (config.group_by_taxon) {
+			timer.go("Grouping sequences by taxon");
 			for (size_t i = 0; i < n; ++i) {
-				sequence seq = (*seqs)[i];
-				MurmurHash3_x64_128(seq.data(), (int)seq.length(), header2.hash, header2.hash);
-				MurmurHash3_x64_128((*ids)[i], ids->length(i), header2.hash, header2.hash);
+				const vector<string> acc = Taxonomy::Accession::from_title((*ids)[i]);
+				unique_ptr<TaxonGroup> &g = groups[top_level_taxon(acc, *nodes)];
+				if (!g)
+					g.reset(new TaxonGroup());
+				const sequence seq = (*seqs)[i];
+				const uint64_t len = seq.length();
+				g->seqs.write(&len, 1);
+				g->seqs.write(seq.data(), len);
+				g->seqs.write((*ids)[i], ids->length(i) + 1);
+				g->accessions << acc;
+				++g->n;
 			}
-			delete seqs;
-			delete ids;
 		}
+		else
+			for (size_t i = 0; i < n; ++i)
+				push_seq((*seqs)[i], (*ids)[i], ids->length(i));
+		if (!config.prot_accession2taxid.empty() && !config.group_by_taxon) {
+			timer.go("Writing accessions");
+			for (size_t i = 0; i < n; ++i)
+				accessions << Taxonomy::Accession::from_title((*ids)[i]);
+		}
+		timer.go("Hashing sequences");
+		hash.get();
+		delete batch.seqs;
+		delete batch.ids;
+		timer.go("Loading sequences");
 	}
-	catch (std::exception&) {
-		out->close();
-		out->remove();
-		throw;
+
+	if (config.group_by_taxon) {
+		timer.go("Writing sequences");
+		auto write_group = [&](unsigned taxon_id, TaxonGroup &g) {
+			g.seqs.rewind();
+			g.accessions.rewind();
+			const uint64_t begin = n_seqs;
+			vector<Letter> seq;
+			string id;
+			vector<string> acc;
+			for (size_t i = 0; i < g.n; ++i) {
+				uint64_t len;
+				g.seqs.read(&len, 1);
+				seq.resize(len);
+				g.seqs.read(seq.data(), len);
+				id.clear();
+				g.seqs.read_to(std::back_inserter(id), '\0');
+				push_seq(sequence(seq), id.c_str(), id.length());
+				g.accessions >> acc;
+				accessions << acc;
+			}
+			taxon_ranges.push_back(TaxonRange{ begin, n_seqs, taxon_id });
+		};
+		for (auto &g : groups)
+			if (g.first != 0)
+				write_group(g.first, *g.second);
+		if (groups.find(0) != groups.end())
+			write_group(0, *groups[0]);
+		groups.clear();
 	}
+	else if (base && !taxon_ranges.empty() && n_seqs > 0)
+		taxon_ranges.push_back(TaxonRange{ base->header.sequences, base->header.sequences + n_seqs, 0 });
 
 	timer.finish();
 
+	timer.go("Writing ids");
+	if (config.packed_seqs) {
+		packer.push(DELIMITER_LETTER);
+		packer.finish();
+	}
+	else {
+		const string padding(Sequence_set::PERIMETER_PADDING + 1, SEQ_DELIMITER);
+		out->write(padding.data(), padding.length());
+	}
+	const uint64_t id_section_offset = out->tell();
+	if (base)
+		base->copy(out, base->id_section_size);
+	id_buffer.rewind();
+	vector<char> buf(1 << 20);
+	size_t n;
+	while ((n = id_buffer.read(buf.data(), buf.size())) > 0)
+		out->write(buf.data(), n);
+	timer.finish();
+
 	timer.go("Writing trailer");
-	header.pos_array_offset = offset;
+	header.pos_array_offset = out->tell();
+	const uint64_t base_seqs = base ? base->header.sequences : 0;
+	if (base) {
+		base->copy(out, base_seqs * Pos_record::SIZE);
+		base->copy(nullptr, Pos_record::SIZE);
+	}
 	pos_array.emplace_back(offset, 0);
 	for (const Pos_record& r : pos_array)
 		*out << r;
+	header2.id_array_offset = out->tell();
+	if (base) {
+		for (uint64_t i = 0; i < base_seqs; ++i) {
+			uint64_t p;
+			base->tail >> p;
+			*out << p - base->id_section_offset + id_section_offset;
+		}
+		base->copy(nullptr, sizeof(uint64_t));
+	}
+	for (uint64_t i : id_array)
+		*out << id_section_offset + i;
+	*out << id_section_offset + id_offset;
 	timer.finish();
 
-	taxonomy.init();
-	if (!config.prot_accession2taxid.empty()) {
+	if (!config.prot_accession2taxid.empty() || (base && base->header2.taxon_array_offset != 0)) {
+		// Sequences without accession mapping get empty taxon lists.
 		header2.taxon_array_offset = out->tell();
-		TaxonList::build(*out, accessions.rewind(), n_seqs);
+		if (base && base->header2.taxon_array_offset != 0)
+			base->copy(out, base->header2.taxon_array_size);
+		else {
+			out->set(Serializer::VARINT);
+			for (uint64_t i = 0; i < base_seqs; ++i)
+				*out << std::set<unsigned>();
+		}
+		if (!config.prot_accession2taxid.empty())
+			TaxonList::build(*out, accessions.rewind(), n_seqs);
+		else {
+			out->set(Serializer::VARINT);
+			for (size_t i = 0; i < n_seqs; ++i)
+				*out << std::set<unsigned>();
+		}
 		header2.taxon_array_size = out->tell() - header2.taxon_array_offset;
 	}
 	if (!config.nodesdmp.empty()) {
+		if (base)
+			base->copy(nullptr, base->nodes_size);
 		header2.taxon_nodes_offset = out->tell();
 		TaxonomyNodes::build(*out);
 	}
+	else if (base && base->nodes_size) {
+		header2.taxon_nodes_offset = out->tell();
+		base->copy(out, base->nodes_size);
+	}
 	if (!config.namesdmp.empty()) {
 		header2.taxon_names_offset = out->tell();
 		*out << taxonomy.name_;
 	}
+	else if (base && base->names_size) {
+		header2.taxon_names_offset = out->tell();
+		base->copy(out, base->names_size);
+	}
+	if (!taxon_ranges.empty()) {
+		header2.taxon_ranges_offset = out->tell();
+		out->unset(Serializer::VARINT);
+		*out << (uint64_t)taxon_ranges.size();
+		for (const TaxonRange &r : taxon_ranges)
+			*out << r.begin << r.end << (uint64_t)r.taxon_id;
+	}
 
 	if (!input_file) {
 		timer.go("Closing the input file");
@@ -283,8 +644,8 @@ void make_db(TempFile **tmp_out, TextInputFile *input_file)
 	}
 
 	timer.go("Closing the database file");
-	header.letters = letters;
-	header.sequences = n_seqs;
+	header.letters = letters + (base ? base->header.letters : 0);
+	header.sequences = n_seqs + base_seqs;
 	out->seek(0);
 	*out << header;
 	*out << header2;
@@ -292,12 +653,26 @@ void make_db(TempFile **tmp_out, TextInputFile *input_file)
 		*tmp_out = static_cast<TempFile*>(out);
 	} else {
 		out->close();
+		remove_on_error.out = nullptr;
 		delete out;
+		if (base) {
+			base->tail.close();
+			if (!replace_file(out_file_name, config.database))
+				throw std::runtime_error("Error renaming file " + out_file_name);
+		}
 	}
 
 	timer.finish();
 	message_stream << "Database hash = " << hex_print(header2.hash, 16) << endl;
 	message_stream << "Processed " << n_seqs << " sequences, " << letters << " letters." << endl;
+	if (config.group_by_taxon)
+		message_stream << "Sequences grouped into " << taxon_ranges.size() << " taxon ranges." << endl;
+	if (base)
+		message_stream << "Database now contains " << header.sequences << " sequences, " << header.letters << " letters." << endl;
+	if (config.seed_index && !tmp_out)
+		build_seed_index();
+	if (config.global_freq && !tmp_out)
+		build_seed_frequency();
 	message_stream << "Total time = " << total.get() << "s" << endl;
 }
 
@@ -310,12 +685,96 @@ size_t DatabaseFile::tell_seq() const {
 }
 
 void DatabaseFile::seek_direct() {
-	seek(sizeof(ReferenceHeader) + sizeof(ReferenceHeader2) + 8);
+	seek(ref_header.pos_array_offset);
+	Pos_record r;
+	*this >> r;
+	if (ref_header.db_version >= SEPARATE_IDS_DB_VERSION) {
+		seq_read_pos_ = r.pos + 1;
+		id_read_pos_ = read_id_array(0, 1).front();
+		seq_read_count_ = 0;
+	}
+	else
+		seq_read_pos_ = r.pos;
+	if (!packed_)
+		seek(seq_read_pos_);
 }
 
-bool DatabaseFile::load_seqs(vector<uint32_t>* block2db_id, const size_t max_letters, Sequence_set **dst_seq, String_set<char, 0> **dst_id, bool load_ids, const BitVector* filter, const bool fetch_seqs, const Chunk & chunk)
+void DatabaseFile::read_at(uint64_t offset, char *dst, size_t n)
 {
-	task_timer timer("Loading reference sequences");
+	if (mapped_file_)
+		memcpy(dst, mapped_file_->data(offset), n);
+	else {
+		seek(offset);
+		if (read(dst, n) != n)
+			throw std::runtime_error("Unexpected end of file.");
+	}
+}
+
+void DatabaseFile::finish_seq(Letter *seq, size_t len, size_t &masked) const
+{
+	if (apply_stored_masks)
+		Masking::get().bit_to_hard_mask(seq, len, masked);
+	else
+		Masking::get().remove_bit_mask(seq, len);
+}
+
+bool DatabaseFile::has_stored_masks() const
+{
+	return header2.masking_id != 0 && Masking::instance && header2.masking_id == Masking::get().parameter_id();
+}
+
+vector<TaxonRange> DatabaseFile::taxon_ranges()
+{
+	vector<TaxonRange> r;
+	if (header2.taxon_ranges_offset == 0)
+		return r;
+	seek(header2.taxon_ranges_offset);
+	varint = false;
+	uint64_t n, taxon_id;
+	*this >> n;
+	r.resize(n);
+	for (TaxonRange &i : r) {
+		*this >> i.begin >> i.end >> taxon_id;
+		i.taxon_id = (unsigned)taxon_id;
+	}
+	return r;
+}
+
+uint64_t DatabaseFile::letter_offset(uint64_t pos) const
+{
+	using namespace Util::Sequence;
+	return packed_ ? header2.seq_section_offset + pos / PACKED_GROUP_LETTERS * PACKED_GROUP_BYTES : pos;
+}
+
+void DatabaseFile::read_letters(uint64_t begin, uint64_t end, Letter *dst)
+{
+	using namespace Util::Sequence;
+	if (!packed_) {
+		read_at(begin, (char*)dst, end - begin);
+		return;
+	}
+	const uint64_t first = begin / PACKED_GROUP_LETTERS * PACKED_GROUP_LETTERS, offset = letter_offset(begin);
+	if (mapped_file_)
+		unpack_range((const uint8_t*)mapped_file_->data(offset), begin - first, end - first, dst);
+	else {
+		vector<uint8_t> buf(letter_offset(end + PACKED_GROUP_LETTERS - 1) - offset);
+		read_at(offset, (char*)buf.data(), buf.size());
+		unpack_range(buf.data(), begin - first, end - first, dst);
+	}
+}
+
+vector<uint64_t> DatabaseFile::read_id_array(size_t begin, size_t end)
+{
+	vector<uint64_t> v(end - begin);
+	read_at(header2.id_array_offset + begin * sizeof(uint64_t), (char*)v.data(), v.size() * sizeof(uint64_t));
+	for (uint64_t &i : v)
+		i = big_endian_byteswap(i);
+	return v;
+}
+
+bool DatabaseFile::load_seqs(vector<uint32_t>* block2db_id, const size_t max_letters, Sequence_set **dst_seq, String_set<char, 0> **dst_id, bool load_ids, const BitVector* filter, const bool fetch_seqs, const Chunk & chunk, unsigned timer_level, bool *blocked)
+{
+	task_timer timer("Loading reference sequences", timer_level);
 
 	if (max_letters > 0) {
 		seek(pos_array_offset);
@@ -324,11 +783,14 @@ bool DatabaseFile::load_seqs(vector<uint32_t>* block2db_id, const size_t max_let
 		seek(chunk.offset);
 	}
 
-	size_t database_id = tell_seq();
-	size_t letters = 0, seqs = 0, id_letters = 0, seqs_processed = 0, filtered_seq_count = 0;
-	vector<uint64_t> filtered_pos;
-	vector<bool> filtered_seqs;
-	if (block2db_id) block2db_id->clear();
+	const bool separate_ids = ref_header.db_version >= SEPARATE_IDS_DB_VERSION;
+	const size_t first_database_id = tell_seq();
+	size_t database_id = first_database_id;
+	size_t letters = 0, seqs = 0, seqs_processed = 0, filtered_seq_count = 0;
+	vector<uint64_t> filtered_pos, seq_pos;
+	vector<uint32_t> local_db_id;
+	vector<uint32_t> &db_id = block2db_id ? *block2db_id : local_db_id;
+	db_id.clear();
 
 	if (fetch_seqs) {
 		*dst_seq = new Sequence_set;
@@ -349,32 +811,40 @@ bool DatabaseFile::load_seqs(vector<uint32_t>* block2db_id, const size_t max_let
 
 	// while (r.seq_len > 0 && letters < max_letters) {
 	while (goon()) {
+		if (filter && max_letters > 0 && !filter->get(database_id)) {
+			// Runs of filtered sequences, like the skipped taxon ranges of a grouped database, are jumped over
+			// in the position array.
+			const size_t n = std::min((size_t)ref_header.sequences, filter->next_set(database_id)) - database_id;
+			if (n > 1) {
+				pos_array_offset += n * Pos_record::SIZE;
+				database_id += n;
+				seqs_processed += n;
+				seqs += n;
+				seek(pos_array_offset);
+				(*this) >> r;
+				last = false;
+				continue;
+			}
+		}
 		Pos_record r_next;
 		(*this) >> r_next;
 		if (!filter || filter->get(database_id)) {
 			letters += r.seq_len;
 			if (fetch_seqs) {
 				(*dst_seq)->reserve(r.seq_len);
-			}
-			const size_t id_len = r_next.pos - r.pos - r.seq_len - 3;
-			id_letters += id_len;
-			if (fetch_seqs) {
-				if (load_ids) (*dst_id)->reserve(id_len);
+				if (load_ids && !separate_ids) (*dst_id)->reserve(r_next.pos - r.pos - r.seq_len - 3);
+				if (mapped_file_ || separate_ids)
+					seq_pos.push_back(r.pos);
 			}
 			//++seqs;
 			++filtered_seq_count;
-			if (block2db_id) block2db_id->push_back((unsigned)database_id);
-			if (filter) {
+			db_id.push_back((unsigned)database_id);
+			if (filter)
 				filtered_pos.push_back(last ? 0 : r.pos);
-				filtered_seqs.push_back(true);
-			}
 			last = true;
 		}
-		else {
+		else
 			last = false;
-			if (filter)
-				filtered_seqs.push_back(false);
-		}
 		pos_array_offset += Pos_record::SIZE;
 		++database_id;
 		++seqs_processed;
@@ -392,46 +862,138 @@ bool DatabaseFile::load_seqs(vector<uint32_t>* block2db_id, const size_t max_let
 		return false;
 	}
 
+	// A block of consecutive byte encoded sequences without mask bits is stored in the layout of the sequence set. If
+	// the mapping around it holds only letters and delimiters to serve as the perimeter padding, the block is used in
+	// place. This is the case for all blocks of databases built with the padding around the sequence section.
+	const uint64_t view_begin = fetch_seqs && !seq_pos.empty() ? seq_pos.front() + 1 : 0;
+	const bool view = fetch_seqs && map_seqs && mapped_file_ && separate_ids && !packed_ && header2.masking_id == 0
+		&& db_id.back() - db_id.front() + 1 == filtered_seq_count
+		&& view_begin >= (uint64_t)Sequence_set::PERIMETER_PADDING
+		&& view_begin + (*dst_seq)->raw_len() <= mapped_file_->size()
+		&& letters_only(mapped_file_->data(view_begin - Sequence_set::PERIMETER_PADDING), Sequence_set::PERIMETER_PADDING)
+		&& letters_only(mapped_file_->data(view_begin - Sequence_set::PERIMETER_PADDING + (*dst_seq)->raw_len()), Sequence_set::PERIMETER_PADDING);
+
 	if (fetch_seqs) {
-		(*dst_seq)->finish_reserve();
+		size_t masked = 0;
+		if (view)
+			(*dst_seq)->finish_reserve((Letter*)mapped_file_->data(view_begin - Sequence_set::PERIMETER_PADDING));
+		else
+			(*dst_seq)->finish_reserve();
+		vector<uint64_t> id_pos;
+		if (load_ids && separate_ids) {
+			id_pos = read_id_array(first_database_id, database_id + 1);
+			for (size_t i = 0; i < filtered_seq_count; ++i) {
+				const size_t j = db_id[i] - first_database_id;
+				(*dst_id)->reserve(id_pos[j + 1] - id_pos[j] - 1);
+			}
+		}
 		if(load_ids) (*dst_id)->finish_reserve();
-		seek(start_offset);
 
-		for (size_t i = 0; i < filtered_seq_count; ++i) {
-			if (filter && filtered_pos[i]) seek(filtered_pos[i]);
-			/*if (filter && !filtered_seqs[i]) {
-				skip_seq();
-				continue;
-			}*/
-			read((*dst_seq)->ptr(i) - 1, (*dst_seq)->length(i) + 2);
-			*((*dst_seq)->ptr(i) - 1) = sequence::DELIMITER;
-			*((*dst_seq)->ptr(i) + (*dst_seq)->length(i)) = sequence::DELIMITER;
-			if (load_ids)
-				read((*dst_id)->ptr(i), (*dst_id)->length(i) + 1);
-			else
-				if (!seek_forward('\0')) throw std::runtime_error("Unexpected end of file.");
-			Masking::get().remove_bit_mask((*dst_seq)->ptr(i), (*dst_seq)->length(i));
+		if (view) {
+			if (load_ids) {
+				const uint64_t id_begin = id_pos[db_id.front() - first_database_id], id_end = id_pos[db_id.back() - first_database_id + 1];
+				read_at(id_begin, (*dst_id)->ptr(0), id_end - id_begin);
+			}
+		}
+		else if (separate_ids) {
+			if (mapped_file_)
+				mapped_file_->advise_sequential(letter_offset(start_offset), letter_offset(r.pos) - letter_offset(start_offset));
+			// Runs of consecutive sequences are stored with single delimiters in between, matching the
+			// layout of the sequence set, and are read with one copy for the sequences and one for the ids.
+			for (size_t i = 0; i < filtered_seq_count;) {
+				size_t j = i + 1;
+				while (j < filtered_seq_count && db_id[j] == db_id[j - 1] + 1)
+					++j;
+				Letter *begin = (*dst_seq)->ptr(i) - 1, *end = (*dst_seq)->ptr(j - 1) + (*dst_seq)->length(j - 1) + 1;
+				read_letters(seq_pos[i], seq_pos[i] + (end - begin), begin);
+				if (load_ids) {
+					const uint64_t id_begin = id_pos[db_id[i] - first_database_id], id_end = id_pos[db_id[j - 1] - first_database_id + 1];
+					read_at(id_begin, (*dst_id)->ptr(i), id_end - id_begin);
+				}
+				i = j;
+			}
+			for (size_t i = 0; i < filtered_seq_count; ++i)
+				finish_seq((*dst_seq)->ptr(i), (*dst_seq)->length(i), masked);
+		}
+		else if (mapped_file_) {
+			mapped_file_->advise_sequential(start_offset, r.pos - start_offset);
+			for (size_t i = 0; i < filtered_seq_count; ++i) {
+				Letter *seq = (*dst_seq)->ptr(i);
+				const size_t len = (*dst_seq)->length(i);
+				const char *src = mapped_file_->data(seq_pos[i]);
+				memcpy(seq, src + 1, len);
+				seq[-1] = seq[len] = sequence::DELIMITER;
+				if (load_ids)
+					memcpy((*dst_id)->ptr(i), src + len + 2, (*dst_id)->length(i) + 1);
+				finish_seq(seq, len, masked);
+			}
+		}
+		else {
+			seek(start_offset);
+
+			for (size_t i = 0; i < filtered_seq_count; ++i) {
+				if (filter && filtered_pos[i]) seek(filtered_pos[i]);
+				read((*dst_seq)->ptr(i) - 1, (*dst_seq)->length(i) + 2);
+				*((*dst_seq)->ptr(i) - 1) = sequence::DELIMITER;
+				*((*dst_seq)->ptr(i) + (*dst_seq)->length(i)) = sequence::DELIMITER;
+				if (load_ids)
+					read((*dst_id)->ptr(i), (*dst_id)->length(i) + 1);
+				else
+					if (!seek_forward('\0')) throw std::runtime_error("Unexpected end of file.");
+				finish_seq((*dst_seq)->ptr(i), (*dst_seq)->length(i), masked);
+			}
 		}
 		timer.finish();
+		if (view)
+			log_stream << "Reference block used in place of the memory mapping." << endl;
 		(*dst_seq)->print_stats();
+		if (apply_stored_masks)
+			log_stream << "Masked letters: " << masked << endl;
 	}
 
-	if (config.multiprocessing)
-		blocked_processing = true;
+	const bool b = config.multiprocessing || seqs_processed < ref_header.sequences;
+	if (blocked)
+		*blocked = b;
 	else
-		blocked_processing = seqs_processed < ref_header.sequences;
+		blocked_processing = b;
 
 	return true;
 }
 
 void DatabaseFile::read_seq(string &id, vector<Letter> &seq)
 {
-	char c;
-	read(&c, 1);
 	seq.clear();
 	id.clear();
-	read_to(std::back_inserter(seq), '\xff');
-	read_to(std::back_inserter(id), '\0');
+	if (ref_header.db_version < SEPARATE_IDS_DB_VERSION) {
+		char c;
+		read(&c, 1);
+		read_to(std::back_inserter(seq), '\xff');
+		read_to(std::back_inserter(id), '\0');
+		return;
+	}
+	if (packed_) {
+		// Packed sequences are not delimited on the byte level, the length is taken from the position array.
+		uint64_t r[2];
+		read_at(ref_header.pos_array_offset + seq_read_count_ * Pos_record::SIZE, (char*)r, Pos_record::SIZE);
+		const uint64_t pos = big_endian_byteswap(r[0]);
+		const uint32_t len = (uint32_t)big_endian_byteswap(r[1]);
+		seq.resize(len);
+		read_letters(pos + 1, pos + 1 + len, seq.data());
+	}
+	else
+		// The trailing delimiter of a sequence is the leading delimiter of the next one.
+		read_to(std::back_inserter(seq), SEQ_DELIMITER);
+	seq_read_pos_ += seq.size() + 1;
+	++seq_read_count_;
+	if (mapped_file_)
+		id = mapped_file_->data(id_read_pos_);
+	else {
+		seek(id_read_pos_);
+		read_to(std::back_inserter(id), '\0');
+		if (!packed_)
+			seek(seq_read_pos_);
+	}
+	id_read_pos_ += id.length() + 1;
 }
 
 void DatabaseFile::skip_seq()
@@ -461,6 +1023,7 @@ void DatabaseFile::get_seq()
 
 	vector<Letter> seq;
 	string id;
+	seek_direct();
 	bool all = config.seq_no.size() == 0 && seq_titles.empty();
 	std::set<size_t> seqs;
 	if (!all)
@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../util/io/serializer.h"
 #include "../util/io/input_file.h"
 #include "../util/io/text_input_file.h"
+#include "../util/io/mapped_file.h"
 #include "../data/seed_histogram.h"
 #include "sequence_set.h"
 #include "metadata.h"
@@ -50,7 +51,7 @@ struct ReferenceHeader
 	uint64_t magic_number;
 	uint32_t build, db_version;
 	uint64_t sequences, letters, pos_array_offset;
-	enum { current_db_version = 3 };
+	enum { current_db_version = 5 };
 	static constexpr uint64_t MAGIC_NUMBER = 0x24af8a415ee186dllu;
 	friend InputFile& operator>>(InputFile& file, ReferenceHeader& h);
 };
@@ -61,12 +62,24 @@ struct ReferenceHeader2
 		taxon_array_offset(0),
 		taxon_array_size(0),
 		taxon_nodes_offset(0),
-		taxon_names_offset(0)
+		taxon_names_offset(0),
+		id_array_offset(0),
+		seq_section_offset(0),
+		seq_encoding(BYTE_ENCODING),
+		masking_id(0),
+		taxon_ranges_offset(0)
 	{
 		memset(hash, 0, sizeof(hash));
 	}
 	char hash[16];
-	uint64_t taxon_array_offset, taxon_array_size, taxon_nodes_offset, taxon_names_offset;
+	uint64_t taxon_array_offset, taxon_array_size, taxon_nodes_offset, taxon_names_offset, id_array_offset, seq_section_offset, seq_encoding;
+	// Masking::parameter_id() of the mask bits set on the stored sequences, 0 if none are recorded.
+	uint64_t masking_id;
+	// Offset of the table of taxon ranges written by makedb --group-by-taxon, 0 if absent.
+	uint64_t taxon_ranges_offset;
+
+	// Encodings of the sequence section. With PACKED_ENCODING, Pos_record positions count letters from seq_section_offset.
+	enum { BYTE_ENCODING = 0, PACKED_ENCODING = 1 };
 
 	friend Serializer& operator<<(Serializer &s, const ReferenceHeader2 &h);
 	friend Deserializer& operator>>(Deserializer &d, ReferenceHeader2 &h);
@@ -96,6 +109,7 @@ struct DatabaseFile : public InputFile
 
 	DatabaseFile(const string &file_name);
 	DatabaseFile(TempFile &tmp_file);
+	~DatabaseFile();
 	static void read_header(InputFile &stream, ReferenceHeader &header);
 	static DatabaseFile* auto_create_from_fasta();
 	static bool is_diamond_db(const string &file_name);
@@ -110,7 +124,10 @@ struct DatabaseFile : public InputFile
 	void clear_partition();
 	size_t get_n_partition_chunks();
 
-	bool load_seqs(std::vector<uint32_t>* block2db_id, size_t max_letters, Sequence_set **dst_seq, String_set<char, 0> **dst_id, bool load_ids = true, const BitVector* filter = nullptr, const bool fetch_seqs = true, const Chunk & chunk = Chunk());
+	// Loads the next block of sequences. The timer is reported at timer_level, which loads running in the background
+	// raise. Whether the block covers only part of the database is returned in blocked if it is not nullptr, otherwise
+	// it is set in the global blocked_processing.
+	bool load_seqs(std::vector<uint32_t>* block2db_id, size_t max_letters, Sequence_set **dst_seq, String_set<char, 0> **dst_id, bool load_ids = true, const BitVector* filter = nullptr, const bool fetch_seqs = true, const Chunk & chunk = Chunk(), unsigned timer_level = 1, bool *blocked = nullptr);
 
 	void get_seq();
 	void read_seq(string &id, vector<Letter> &seq);
@@ -123,10 +140,19 @@ struct DatabaseFile : public InputFile
 	size_t tell_seq() const;
 	void seek_direct();
 	size_t total_blocks() const;
+	bool has_stored_masks() const;
+	std::vector<TaxonRange> taxon_ranges();
 
-	enum { min_build_required = 74, MIN_DB_VERSION = 2 };
+	// From SUM_HASH_DB_VERSION on, the database hash is the sum of the per-sequence hashes instead of a hash chained
+	// over all sequences in file order.
+	enum { min_build_required = 74, MIN_DB_VERSION = 2, SEPARATE_IDS_DB_VERSION = 4, SUM_HASH_DB_VERSION = 5 };
 
 	bool temporary;
+	// Convert the stored mask bits to hard masks on loading instead of removing them.
+	bool apply_stored_masks;
+	// Load the sequences of a block as a read-only view of the memory mapping of the database file if possible. This
+	// is only done if the database stores no mask bits, and the caller must not modify the sequences.
+	bool map_seqs;
 	size_t pos_array_offset;
 	ReferenceHeader ref_header;
 	ReferenceHeader2 header2;
@@ -144,6 +170,16 @@ struct DatabaseFile : public InputFile
 
 private:
 	void init();
+	void finish_seq(Letter *seq, size_t len, size_t &masked) const;
+	void read_at(uint64_t offset, char *dst, size_t n);
+	std::vector<uint64_t> read_id_array(size_t begin, size_t end);
+	uint64_t letter_offset(uint64_t pos) const;
+	void read_letters(uint64_t begin, uint64_t end, Letter *dst);
+
+	bool packed_;
+	uint64_t seq_read_pos_, id_read_pos_, seq_read_count_;
+	// Memory mapping of the database file used to fetch sequences in load_seqs, nullptr if unavailable.
+	MappedFile *mapped_file_;
 
 };
 
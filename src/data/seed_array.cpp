@@ -17,8 +17,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
 #include <stdint.h>
+#include <thread>
+#include <memory>
 #include "seed_array.h"
 #include "seed_set.h"
+#include "../util/system/system.h"
 
 typedef vector<Array<SeedArray::Entry*, Const::seedp> > PtrSet;
 
@@ -96,9 +99,19 @@ struct BuildCallback
 	BufferedWriter *it;
 };
 
+SeedArray::SeedArray(const shape_histogram &hst, const SeedPartitionRange &range, char *buffer) :
+	data_((Entry*)buffer),
+	own_buffer_(nullptr)
+{
+	begin_[range.begin()] = 0;
+	for (size_t i = range.begin(); i < range.end(); ++i)
+		begin_[i + 1] = begin_[i] + partition_size(hst, i);
+}
+
 template<typename _filter>
-SeedArray::SeedArray(const Sequence_set &seqs, size_t shape, const shape_histogram &hst, const SeedPartitionRange &range, const vector<size_t> &seq_partition, char *buffer, const _filter *filter) :
-	data_((Entry*)buffer)
+SeedArray::SeedArray(const Sequence_set &seqs, size_t shape, const shape_histogram &hst, const SeedPartitionRange &range, const vector<size_t> &seq_partition, char *buffer, const _filter *filter, size_t minimizer_window, size_t threads) :
+	data_((Entry*)buffer),
+	own_buffer_(nullptr)
 {
 	begin_[range.begin()] = 0;
 	for (size_t i = range.begin(); i < range.end(); ++i)
@@ -108,9 +121,146 @@ SeedArray::SeedArray(const Sequence_set &seqs, size_t shape, const shape_histogr
 	PtrVector<BuildCallback> cb;
 	for (size_t i = 0; i < seq_partition.size() - 1; ++i)
 		cb.push_back(new BuildCallback(range, iterators[i].begin()));
+	seqs.enum_seeds(cb, seq_partition, shape, shape + 1, filter, false, minimizer_window, threads);
+}
+
+// Entries of a sequence range, appended to per partition lists of fixed size chunks. The chunks are carved from
+// larger slabs, so the memory overhead is at most one chunk per partition and the entries are never moved before
+// they are copied to the seed array.
+struct BucketCallback
+{
+	enum { CHUNK_SIZE = 256, SLAB_CHUNKS = 64 };
+	struct Bucket {
+		Bucket():
+			size(0)
+		{}
+		vector<SeedArray::Entry*> chunks;
+		size_t size;
+	};
+	BucketCallback(const SeedPartitionRange &range) :
+		range(range),
+		buckets(range.size()),
+		slab_used(SLAB_CHUNKS)
+	{ }
+	bool operator()(uint64_t seed, uint64_t pos, size_t shape)
+	{
+		const unsigned p = seed_partition(seed);
+		if (range.contains(p)) {
+			Bucket &b = buckets[p - range.begin()];
+			if (b.size % CHUNK_SIZE == 0)
+				b.chunks.push_back(alloc_chunk());
+			b.chunks.back()[b.size++ % CHUNK_SIZE] = SeedArray::Entry(seed_partition_offset(seed), pos);
+		}
+		return true;
+	}
+	void finish()
+	{
+	}
+	void copy(size_t bucket, SeedArray::Entry *dst) const
+	{
+		const Bucket &b = buckets[bucket];
+		for (size_t i = 0; i < b.chunks.size(); ++i)
+			memcpy(dst + i * CHUNK_SIZE, b.chunks[i], std::min((size_t)CHUNK_SIZE, b.size - i * CHUNK_SIZE) * sizeof(SeedArray::Entry));
+	}
+	void clear()
+	{
+		vector<Bucket>().swap(buckets);
+		slabs.clear();
+	}
+	SeedPartitionRange range;
+	vector<Bucket> buckets;
+private:
+	SeedArray::Entry* alloc_chunk()
+	{
+		if (slab_used == SLAB_CHUNKS) {
+			slabs.emplace_back(new char[sizeof(SeedArray::Entry) * CHUNK_SIZE * SLAB_CHUNKS]);
+			slab_used = 0;
+		}
+		return (SeedArray::Entry*)slabs.back().get() + CHUNK_SIZE * slab_used++;
+	}
+	vector<std::unique_ptr<char[]>> slabs;
+	size_t slab_used;
+};
+
+struct PartitionCountCallback
+{
+	PartitionCountCallback(unsigned *counts):
+		counts(counts)
+	{ }
+	bool operator()(uint64_t seed, uint64_t pos, size_t shape)
+	{
+		++counts[seed_partition(seed)];
+		return true;
+	}
+	void finish()
+	{
+	}
+	unsigned *counts;
+};
+
+template<typename _filter>
+SeedArray::SeedArray(const Sequence_set &seqs, size_t shape, const SeedPartitionRange &range, const vector<size_t> &seq_partition, const _filter *filter)
+{
+	const size_t n = seq_partition.size() - 1;
+	// The single pass layout holds the entries of the partition range twice while they are copied into the array. Each
+	// letter contributes at most one seed, which gives an upper bound for the size of the array. Only if that does not
+	// fit into the available memory, the seeds are enumerated twice to count and fill the partitions.
+	const double ram = available_ram(), max_size = (double)seqs.letters() * range.size() / Const::seedp * sizeof(Entry);
+	if (ram > 0.0 && ram * 1e9 < 4 * max_size) {
+		shape_histogram hst(n);
+		PtrVector<PartitionCountCallback> count_cb;
+		for (size_t i = 0; i < n; ++i)
+			count_cb.push_back(new PartitionCountCallback(hst[i].begin()));
+		seqs.enum_seeds(count_cb, seq_partition, shape, shape + 1, filter);
+		begin_[range.begin()] = 0;
+		for (size_t i = range.begin(); i < range.end(); ++i)
+			begin_[i + 1] = begin_[i] + partition_size(hst, i);
+		own_buffer_ = new char[sizeof(Entry) * begin_[range.end()]];
+		data_ = (Entry*)own_buffer_;
+
+		PtrSet iterators(build_iterators(*this, hst));
+		PtrVector<BuildCallback> cb;
+		for (size_t i = 0; i < n; ++i)
+			cb.push_back(new BuildCallback(range, iterators[i].begin()));
+		seqs.enum_seeds(cb, seq_partition, shape, shape + 1, filter);
+		return;
+	}
+
+	PtrVector<BucketCallback> cb;
+	for (size_t i = 0; i < n; ++i)
+		cb.push_back(new BucketCallback(range));
 	seqs.enum_seeds(cb, seq_partition, shape, shape + 1, filter);
+
+	// Within a partition, the entries of the sequence ranges follow each other in order, as in the histogram based
+	// layout.
+	vector<vector<size_t>> offset(n, vector<size_t>(range.size()));
+	begin_[range.begin()] = 0;
+	for (unsigned p = range.begin(); p < range.end(); ++p) {
+		size_t s = begin_[p];
+		for (size_t i = 0; i < n; ++i) {
+			offset[i][p - range.begin()] = s;
+			s += cb[i].buckets[p - range.begin()].size;
+		}
+		begin_[p + 1] = s;
+	}
+	own_buffer_ = new char[sizeof(Entry) * begin_[range.end()]];
+	data_ = (Entry*)own_buffer_;
+
+	auto worker = [this, &cb, &offset](size_t i) {
+		for (size_t j = 0; j < cb[i].buckets.size(); ++j)
+			cb[i].copy(j, data_ + offset[i][j]);
+		cb[i].clear();
+	};
+	vector<std::thread> threads;
+	for (size_t i = 0; i < n; ++i)
+		threads.emplace_back(worker, i);
+	for (auto &t : threads)
+		t.join();
 }
 
-template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const No_filter *);
-template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const Seed_set *);
-template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const Hashed_seed_set *);
\ No newline at end of file
+template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const No_filter *, size_t, size_t);
+template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const Seed_set *, size_t, size_t);
+template SeedArray::SeedArray(const Sequence_set &, size_t, const shape_histogram &, const SeedPartitionRange &, const vector<size_t>&, char *buffer, const Hashed_seed_set *, size_t, size_t);
+template SeedArray::SeedArray(const Sequence_set &, size_t, const SeedPartitionRange &, const vector<size_t>&, const No_filter *);
+template SeedArray::SeedArray(const Sequence_set &, size_t, const SeedPartitionRange &, const vector<size_t>&, const Seed_set *);
+template SeedArray::SeedArray(const Sequence_set &, size_t, const SeedPartitionRange &, const vector<size_t>&, const Hashed_seed_set *);
\ No newline at end of file
@@ -50,8 +50,26 @@ struct SeedArray
 		typedef uint32_t Key;
 	} PACKED_ATTRIBUTE;
 
+	SeedArray(const shape_histogram &hst, const SeedPartitionRange &range, char *buffer);
+
+	// The minimizer window needs to match the one used for the histogram. With threads > 0, at most this many threads
+	// enumerate the seeds.
+	template<typename _filter>
+	SeedArray(const Sequence_set &seqs, size_t shape, const shape_histogram &hst, const SeedPartitionRange &range, const vector<size_t> &seq_partition, char *buffer, const _filter *filter, size_t minimizer_window = 1, size_t threads = 0);
+
+	// Builds the array in a single pass over the seeds, without a histogram. The buffer is owned by the object. With
+	// several index chunks or when memory is short, the partitions are counted in a first pass instead, so that the
+	// entries are written to the array directly.
 	template<typename _filter>
-	SeedArray(const Sequence_set &seqs, size_t shape, const shape_histogram &hst, const SeedPartitionRange &range, const vector<size_t> &seq_partition, char *buffer, const _filter *filter);
+	SeedArray(const Sequence_set &seqs, size_t shape, const SeedPartitionRange &range, const vector<size_t> &seq_partition, const _filter *filter);
+
+	SeedArray(const SeedArray&) = delete;
+	SeedArray& operator=(const SeedArray&) = delete;
+
+	~SeedArray()
+	{
+		delete[] own_buffer_;
+	}
 
 	Entry* begin(unsigned i)
 	{
@@ -73,6 +91,7 @@ struct SeedArray
 private:
 
 	Entry *data_;
+	char *own_buffer_;
 	size_t begin_[Const::seedp + 1];
 
 };
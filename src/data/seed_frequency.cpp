@@ -0,0 +1,277 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <atomic>
+#include <sstream>
+#include <string.h>
+#include "seed_frequency.h"
+#include "reference.h"
+#include "../basic/config.h"
+#include "../basic/shape_config.h"
+#include "../basic/masking.h"
+#include "../util/log_stream.h"
+#include "../util/system/system.h"
+#include "../util/io/output_file.h"
+#include "../search/search.h"
+
+using std::string;
+using std::vector;
+using std::endl;
+using std::atomic;
+
+SeedFrequency* SeedFrequency::instance = nullptr;
+
+string SeedFrequency::file_name(const string &database)
+{
+	return database + ".seedfreq";
+}
+
+// Unlike the seed index, the frequencies do not depend on the block size.
+string SeedFrequency::signature()
+{
+	std::stringstream ss;
+	ss << "shapes=" << ::shapes
+		<< ";reduction=" << Reduction::reduction
+		<< ";masking=" << (config.no_ref_masking ? 0 : config.masking);
+	if (config.masking == 1 && !config.no_ref_masking)
+		ss << ";matrix=" << (config.matrix_file.empty() ? config.matrix : config.matrix_file)
+			<< ";tantan=" << config.tantan_minMaskProb;
+	return ss.str();
+}
+
+unsigned SeedFrequency::cap(unsigned shape) const
+{
+	return (unsigned)(mean_[shape] + config.freq_sd * sd_[shape]);
+}
+
+// One sketch cell per letter of the database up to the limits, so that the counts of frequent seeds stand out from
+// the collisions also for large databases.
+unsigned SeedFrequency::width_bits(uint64_t letters)
+{
+	unsigned bits = MIN_WIDTH_BITS;
+	while (bits < MAX_WIDTH_BITS && (uint64_t(1) << bits) < letters)
+		++bits;
+	while (bits > MIN_WIDTH_BITS && shapes.count() * DEPTH * sizeof(uint32_t) * (size_t(1) << bits) > MAX_TABLE_SIZE)
+		--bits;
+	return bits;
+}
+
+struct CountCallback
+{
+	CountCallback(vector<atomic<uint32_t>> &counts, unsigned width_bits, uint64_t sample_threshold) :
+		counts(counts),
+		width_bits(width_bits),
+		sample_threshold(sample_threshold)
+	{}
+	bool operator()(uint64_t seed, uint64_t pos, size_t shape)
+	{
+		const size_t width = size_t(1) << width_bits;
+		for (unsigned i = 0; i < SeedFrequency::DEPTH; ++i)
+			counts[i * width + SeedFrequency::cell(seed, i, width_bits)].fetch_add(1, std::memory_order_relaxed);
+		if (SeedFrequency::sampled(seed, sample_threshold))
+			sample.push_back(seed);
+		return true;
+	}
+	void finish()
+	{
+	}
+	vector<atomic<uint32_t>> &counts;
+	const unsigned width_bits;
+	const uint64_t sample_threshold;
+	vector<uint64_t> sample;
+};
+
+SeedFrequency* SeedFrequency::build(DatabaseFile &db_file)
+{
+	const size_t max_letters = (size_t)(config.chunk_size * 1e9);
+	const unsigned width_bits = SeedFrequency::width_bits(db_file.ref_header.letters);
+	const size_t width = size_t(1) << width_bits;
+	// The sample contains about SAMPLE_SIZE distinct seeds if most seeds of the database are distinct.
+	const uint64_t sample_threshold = db_file.ref_header.letters <= SAMPLE_SIZE ? UINT64_MAX
+		: uint64_t((double)SAMPLE_SIZE / db_file.ref_header.letters * (double)UINT64_MAX);
+	log_stream << "Seed frequency table width = 2^" << width_bits << ", size = " << (double)shapes.count() * DEPTH * width * sizeof(uint32_t) / (1 << 20) << " MB" << endl;
+	vector<vector<atomic<uint32_t>>> counts;
+	vector<vector<uint64_t>> samples(shapes.count());
+	for (unsigned s = 0; s < shapes.count(); ++s)
+		counts.emplace_back(DEPTH * width);
+
+	vector<uint32_t> block2db_id;
+	Sequence_set *seqs;
+	String_set<char, 0> *ids;
+	// Masks stored in the database are applied instead of masking the blocks, as in the search.
+	const bool mask = config.masking == 1 && !config.no_ref_masking, apply_stored_masks = db_file.apply_stored_masks;
+	db_file.apply_stored_masks = mask && db_file.has_stored_masks();
+	db_file.rewind();
+	while (db_file.load_seqs(&block2db_id, max_letters, &seqs, &ids, false)) {
+		task_timer timer;
+		if (mask && !db_file.apply_stored_masks) {
+			timer.go("Masking reference");
+			mask_seqs(*seqs, Masking::get());
+		}
+		timer.go("Counting reference seeds");
+		const vector<size_t> p = seqs->partition(config.threads_);
+		for (unsigned s = 0; s < shapes.count(); ++s) {
+			PtrVector<CountCallback> cb;
+			for (size_t i = 0; i < p.size() - 1; ++i)
+				cb.push_back(new CountCallback(counts[s], width_bits, sample_threshold));
+			seqs->enum_seeds(cb, p, s, s + 1, &no_filter);
+			for (CountCallback *c : cb)
+				samples[s].insert(samples[s].end(), c->sample.begin(), c->sample.end());
+			std::sort(samples[s].begin(), samples[s].end());
+			samples[s].erase(std::unique(samples[s].begin(), samples[s].end()), samples[s].end());
+		}
+		delete seqs;
+	}
+	db_file.apply_stored_masks = apply_stored_masks;
+	db_file.rewind();
+
+	task_timer timer("Computing seed frequencies");
+	SeedFrequency *f = new SeedFrequency;
+	f->signature_ = signature();
+	f->width_bits_ = width_bits;
+	vector<uint64_t> totals;
+	for (unsigned s = 0; s < shapes.count(); ++s) {
+		vector<uint32_t> t(DEPTH * width);
+		uint64_t total = 0;
+		for (size_t i = 0; i < t.size(); ++i) {
+			t[i] = counts[s][i].load(std::memory_order_relaxed);
+			if (i < width)
+				total += t[i];
+		}
+		vector<atomic<uint32_t>>().swap(counts[s]);
+		f->counts_.push_back(std::move(t));
+		totals.push_back(total);
+		// The statistics are taken over the estimated counts of the sampled seeds, which include the collisions in
+		// the sketch in the same way as the counts looked up during the search.
+		Sd sd;
+		for (uint64_t seed : samples[s])
+			sd.add((double)f->count(seed, s));
+		vector<uint64_t>().swap(samples[s]);
+		f->mean_.push_back(sd.mean());
+		f->sd_.push_back(sd.sd());
+	}
+	timer.finish();
+	for (unsigned s = 0; s < shapes.count(); ++s) {
+		log_stream << "Seed frequency mean (database, shape " << s << ") = " << f->mean_[s] << ", SD = " << f->sd_[s] << endl;
+		const double load = (double)totals[s] / width;
+		if (load > f->cap(s))
+			message_stream << "Warning: the seed frequency table of shape " << s << " is saturated (mean counter value " << load
+			<< " exceeds the frequency cap " << f->cap(s) << "). Frequent seed masking will be inaccurate." << endl;
+	}
+	return f;
+}
+
+void SeedFrequency::save(const DatabaseFile &db_file) const
+{
+	const string file_name = SeedFrequency::file_name(db_file.file_name);
+	task_timer timer("Writing seed frequency table");
+	OutputFile out(file_name);
+	out << MAGIC_NUMBER;
+	out.write((uint32_t)VERSION);
+	out.write(db_file.header2.hash, 16);
+	out << signature_;
+	out.write((uint32_t)width_bits_);
+	out << (uint64_t)counts_.size();
+	for (size_t s = 0; s < counts_.size(); ++s) {
+		out.write(&mean_[s], 1);
+		out.write(&sd_[s], 1);
+		out.write(counts_[s].data(), counts_[s].size());
+	}
+	out.close();
+	timer.finish();
+	message_stream << "Seed frequency table: " << file_name << endl;
+}
+
+SeedFrequency* SeedFrequency::open(const DatabaseFile &db_file)
+{
+	const string file_name = SeedFrequency::file_name(db_file.file_name);
+	if (!exists(file_name))
+		return nullptr;
+	task_timer timer("Loading the seed frequency table");
+	InputFile in(file_name);
+	in.varint = false;
+	uint64_t magic_number, n;
+	uint32_t version;
+	char hash[16];
+	in >> magic_number;
+	if (magic_number != MAGIC_NUMBER)
+		throw std::runtime_error("File is not a DIAMOND seed frequency table: " + file_name);
+	in.read(version);
+	if (version != VERSION) {
+		timer.finish();
+		verbose_stream << "Seed frequency table was built by a different program version and will not be used." << endl;
+		in.close();
+		return nullptr;
+	}
+	if (in.read(hash, 16) != 16)
+		throw EndOfStream();
+	SeedFrequency *f = new SeedFrequency;
+	uint32_t width_bits;
+	in >> f->signature_;
+	in.read(width_bits);
+	in >> n;
+	if (memcmp(hash, db_file.header2.hash, 16) != 0 || f->signature_ != signature() || n != shapes.count()
+		|| width_bits < MIN_WIDTH_BITS || width_bits > MAX_WIDTH_BITS) {
+		timer.finish();
+		verbose_stream << "Seed frequency table was built for a different database or different search parameters and will not be used." << endl;
+		in.close();
+		delete f;
+		return nullptr;
+	}
+	f->width_bits_ = width_bits;
+	const size_t size = DEPTH * (size_t(1) << width_bits);
+	f->mean_.resize(n);
+	f->sd_.resize(n);
+	f->counts_.resize(n);
+	for (size_t s = 0; s < n; ++s) {
+		f->counts_[s].resize(size);
+		if (in.read(&f->mean_[s], 1) != 1 || in.read(&f->sd_[s], 1) != 1 || in.read(f->counts_[s].data(), size) != size)
+			throw std::runtime_error("Unexpected end of file: " + file_name);
+	}
+	in.close();
+	return f;
+}
+
+SeedFrequency* SeedFrequency::get(DatabaseFile &db_file)
+{
+	SeedFrequency *f = open(db_file);
+	if (f)
+		return f;
+	f = build(db_file);
+	try {
+		f->save(db_file);
+	}
+	catch (std::exception &e) {
+		message_stream << "Warning: the seed frequency table could not be saved (" << e.what() << ")." << endl;
+	}
+	return f;
+}
+
+void build_seed_frequency()
+{
+	setup_search();
+	task_timer timer("Opening the database file", true);
+	DatabaseFile db_file(config.database);
+	timer.finish();
+	SeedFrequency *f = SeedFrequency::build(db_file);
+	f->save(db_file);
+	delete f;
+	db_file.close();
+}
@@ -0,0 +1,95 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <algorithm>
+#include "../util/hash_function.h"
+
+struct DatabaseFile;
+
+// Seed frequencies of a whole database, stored next to the database file. For each shape, a count-min sketch
+// with 32 bit counters estimates how often a seed occurs in the reference. The width of the sketch grows with the
+// size of the database. Frequent seed masking based on this table is the same for all reference blocks.
+struct SeedFrequency
+{
+
+	enum { DEPTH = 2, MIN_WIDTH_BITS = 12, MAX_WIDTH_BITS = 26, SAMPLE_SIZE = 1 << 20, VERSION = 1 };
+	// Upper bound for the size of the sketches of all shapes, the width is reduced down to MIN_WIDTH_BITS to meet it.
+	static constexpr size_t MAX_TABLE_SIZE = (size_t)2 << 30;
+	static constexpr uint64_t MAGIC_NUMBER = 0x1b5d9e07c4a3f268llu;
+
+	unsigned count(uint64_t seed, unsigned shape) const
+	{
+		const uint32_t *t = counts_[shape].data();
+		const size_t width = size_t(1) << width_bits_;
+		uint32_t n = UINT32_MAX;
+		for (unsigned i = 0; i < DEPTH; ++i)
+			n = std::min(n, t[i * width + cell(seed, i, width_bits_)]);
+		return n;
+	}
+
+	// Seeds occurring more often than the mean plus config.freq_sd standard deviations of the frequencies of the
+	// shape are frequent. The statistics are estimated from a random sample of the distinct seeds of the database.
+	unsigned cap(unsigned shape) const;
+
+	bool frequent(uint64_t seed, unsigned shape) const
+	{
+		return count(seed, shape) > cap(shape);
+	}
+
+	static std::string file_name(const std::string &database);
+	static std::string signature();
+	void save(const DatabaseFile &db_file) const;
+
+	static SeedFrequency* build(DatabaseFile &db_file);
+	static SeedFrequency* open(const DatabaseFile &db_file);
+	// Opens the table of the database, or builds and saves it if there is none for the current parameters.
+	static SeedFrequency* get(DatabaseFile &db_file);
+
+	static SeedFrequency *instance;
+
+private:
+
+	static uint32_t cell(uint64_t seed, unsigned row, unsigned width_bits)
+	{
+		return uint32_t(murmur_hash()(seed ^ (0x9e3779b97f4a7c15llu * (row + 1))) & ((uint64_t(1) << width_bits) - 1));
+	}
+
+	// Selects a seed for the sample with a probability of threshold / 2^64, independently of its frequency.
+	static bool sampled(uint64_t seed, uint64_t threshold)
+	{
+		return murmur_hash()(seed ^ 0x5851f42d4c957f2dllu) < threshold;
+	}
+
+	static unsigned width_bits(uint64_t letters);
+
+	friend struct CountCallback;
+
+	std::string signature_;
+	unsigned width_bits_;
+	std::vector<std::vector<uint32_t>> counts_;
+	std::vector<double> mean_, sd_;
+
+};
+
+void build_seed_frequency();
@@ -87,7 +87,7 @@ struct Partitioned_histogram
 	Partitioned_histogram();
 	
 	template<typename _filter>
-	Partitioned_histogram(const Sequence_set &seqs, bool serial, const _filter *filter) :
+	Partitioned_histogram(const Sequence_set &seqs, bool serial, const _filter *filter, size_t minimizer_window = 1) :
 		data_(shapes.count()),
 		p_(seqs.partition(config.threads_))
 	{
@@ -98,11 +98,16 @@ struct Partitioned_histogram
 			cb.push_back(new Callback(i, data_));
 		if (serial)
 			for (unsigned s = 0; s < shapes.count(); ++s)
-				seqs.enum_seeds(cb, p_, s, s + 1, filter);
+				seqs.enum_seeds(cb, p_, s, s + 1, filter, false, minimizer_window);
 		else
-			seqs.enum_seeds(cb, p_, 0, shapes.count(), filter);
+			seqs.enum_seeds(cb, p_, 0, shapes.count(), filter, false, minimizer_window);
 	}
 
+	Partitioned_histogram(vector<shape_histogram> &&data, size_t seq_count):
+		data_(std::move(data)),
+		p_({ 0, seq_count })
+	{ }
+
 	const shape_histogram& get(unsigned sid) const
 	{ return data_[sid]; }
 
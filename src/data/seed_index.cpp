@@ -0,0 +1,233 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <sstream>
+#include <string.h>
+#include "seed_index.h"
+#include "reference.h"
+#include "../basic/config.h"
+#include "../basic/shape_config.h"
+#include "../basic/masking.h"
+#include "../util/log_stream.h"
+#include "../util/system/system.h"
+#include "../search/search.h"
+
+using std::string;
+using std::vector;
+using std::endl;
+
+SeedIndex* SeedIndex::instance = nullptr;
+
+string SeedIndex::file_name(const string &database)
+{
+	return database + ".seedidx";
+}
+
+string SeedIndex::signature()
+{
+	std::stringstream ss;
+	ss << "shapes=" << ::shapes
+		<< ";reduction=" << Reduction::reduction
+		<< ";block=" << (size_t)(config.chunk_size * 1e9)
+		<< ";hashed=" << config.hashed_seeds
+		<< ";masking=" << (config.no_ref_masking ? 0 : config.masking);
+	if (config.masking == 1 && !config.no_ref_masking)
+		ss << ";matrix=" << (config.matrix_file.empty() ? config.matrix : config.matrix_file)
+			<< ";tantan=" << config.tantan_minMaskProb;
+	if (config.minimizer_window > 1)
+		ss << ";minimizer=" << config.minimizer_window;
+	return ss.str();
+}
+
+SeedIndex::SeedIndex(const string &file_name):
+	file_(file_name, InputFile::BUFFERED)
+{
+	uint64_t magic_number, n, table_offset;
+	uint32_t version;
+	file_.varint = false;
+	file_ >> magic_number;
+	if (magic_number != MAGIC_NUMBER)
+		throw std::runtime_error("File is not a DIAMOND seed index: " + file_name);
+	file_.read(version);
+	if (version != VERSION)
+		throw std::runtime_error("Incompatible seed index version: " + file_name);
+	if (file_.read(hash_, 16) != 16)
+		throw EndOfStream();
+	file_ >> signature_ >> n >> table_offset;
+
+	file_.seek(table_offset);
+	blocks_.resize(n);
+	for (Block &b : blocks_) {
+		uint64_t shape_count;
+		file_ >> b.first_seq >> b.seqs >> b.letters >> shape_count;
+		b.shape_offset.resize(shape_count);
+		for (uint64_t &i : b.shape_offset)
+			file_ >> i;
+	}
+}
+
+SeedIndex::~SeedIndex()
+{
+	file_.close();
+}
+
+SeedIndex* SeedIndex::open(const DatabaseFile &db_file)
+{
+	const string file_name = SeedIndex::file_name(db_file.file_name);
+	if (!exists(file_name))
+		return nullptr;
+	task_timer timer("Opening the seed index");
+	SeedIndex *idx = new SeedIndex(file_name);
+	timer.finish();
+	if (memcmp(idx->hash_, db_file.header2.hash, 16) != 0) {
+		message_stream << "Warning: Seed index " << file_name << " does not match the database and will not be used." << endl;
+		delete idx;
+		return nullptr;
+	}
+	if (idx->signature_ != signature()) {
+		verbose_stream << "Seed index was built for different search parameters (" << idx->signature_ << ") and will not be used." << endl;
+		delete idx;
+		return nullptr;
+	}
+	message_stream << "Using seed index: " << file_name << endl;
+	return idx;
+}
+
+bool SeedIndex::has_block(size_t block, const vector<uint32_t> &block2db_id) const
+{
+	if (block >= blocks_.size() || block2db_id.empty())
+		return false;
+	const Block &b = blocks_[block];
+	return b.seqs == block2db_id.size()
+		&& b.first_seq == block2db_id.front()
+		&& b.first_seq + b.seqs - 1 == block2db_id.back()
+		&& b.shape_offset.size() == shapes.count();
+}
+
+Partitioned_histogram SeedIndex::histogram(size_t block)
+{
+	const Block &b = blocks_[block];
+	vector<shape_histogram> data(shapes.count());
+	partition_begin_.assign(shapes.count(), vector<uint64_t>(Const::seedp + 1));
+	for (unsigned s = 0; s < shapes.count(); ++s) {
+		file_.seek(b.shape_offset[s]);
+		data[s].resize(1);
+		vector<uint64_t> &begin = partition_begin_[s];
+		begin[0] = 0;
+		for (unsigned p = 0; p < Const::seedp; ++p) {
+			uint64_t n;
+			file_ >> n;
+			data[s][0][p] = (unsigned)n;
+			begin[p + 1] = begin[p] + n;
+		}
+	}
+	return Partitioned_histogram(std::move(data), b.seqs);
+}
+
+void SeedIndex::load(size_t block, unsigned shape, const SeedPartitionRange &range, SeedArray::Entry *dst)
+{
+	const vector<uint64_t> &begin = partition_begin_[shape];
+	const size_t n = begin[range.end()] - begin[range.begin()];
+	file_.seek(blocks_[block].shape_offset[shape] + Const::seedp * sizeof(uint64_t) + begin[range.begin()] * sizeof(SeedArray::Entry));
+	if (file_.read(dst, n) != n)
+		throw std::runtime_error("Unexpected end of file: " + file_.file_name);
+}
+
+void SeedIndex::build(DatabaseFile &db_file)
+{
+	const string file_name = SeedIndex::file_name(db_file.file_name);
+	message_stream << "Seed index file: " << file_name << endl;
+	message_stream << "Shape configuration: " << ::shapes << endl;
+	const size_t max_letters = (size_t)(config.chunk_size * 1e9);
+	OutputFile out(file_name);
+	const string sig = signature();
+	uint64_t block_count = 0;
+
+	auto write_header = [&](uint64_t table_offset) {
+		out << MAGIC_NUMBER;
+		out.write((uint32_t)VERSION);
+		out.write(db_file.header2.hash, 16);
+		out << sig << block_count << table_offset;
+	};
+	write_header(0);
+
+	vector<Block> blocks;
+	vector<uint32_t> block2db_id;
+	Sequence_set *seqs;
+	String_set<char, 0> *ids;
+	db_file.rewind();
+	while (db_file.load_seqs(&block2db_id, max_letters, &seqs, &ids, false)) {
+		task_timer timer;
+		if (config.masking == 1 && !config.no_ref_masking) {
+			timer.go("Masking reference");
+			mask_seqs(*seqs, Masking::get());
+		}
+		timer.go("Building reference histograms");
+		const Partitioned_histogram hst(*seqs, false, &no_filter, config.minimizer_window);
+		Block b;
+		b.first_seq = block2db_id.front();
+		b.seqs = block2db_id.size();
+		b.letters = seqs->letters();
+
+		for (unsigned s = 0; s < shapes.count(); ++s) {
+			timer.go("Building reference seed array");
+			const size_t n = hst_size(hst.get(s), SeedPartitionRange::all());
+			char *buf = new char[sizeof(SeedArray::Entry) * n];
+			SeedArray sa(*seqs, s, hst.get(s), SeedPartitionRange::all(), hst.partition(), buf, &no_filter, config.minimizer_window);
+			timer.go("Writing seed array");
+			b.shape_offset.push_back(out.tell());
+			for (unsigned p = 0; p < Const::seedp; ++p)
+				out << (uint64_t)partition_size(hst.get(s), p);
+			out.write(sa.begin(0), n);
+			delete[] buf;
+		}
+		blocks.push_back(std::move(b));
+		++block_count;
+		delete seqs;
+	}
+
+	task_timer timer("Writing block table");
+	const uint64_t table_offset = out.tell();
+	for (const Block &b : blocks) {
+		out << b.first_seq << b.seqs << b.letters << (uint64_t)b.shape_offset.size();
+		for (uint64_t i : b.shape_offset)
+			out << i;
+	}
+	out.seek(0);
+	write_header(table_offset);
+	out.close();
+	timer.finish();
+	message_stream << "Seed index blocks: " << block_count << endl;
+}
+
+void build_seed_index()
+{
+	if (config.sensitivity >= Sensitivity::VERY_SENSITIVE)
+		Config::set_option(config.chunk_size, 0.4);
+	else
+		Config::set_option(config.chunk_size, 2.0);
+	config.algo = Config::double_indexed;
+	setup_search();
+	task_timer timer("Opening the database file", true);
+	DatabaseFile db_file(config.database);
+	timer.finish();
+	SeedIndex::build(db_file);
+	db_file.close();
+}
@@ -0,0 +1,70 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "seed_array.h"
+#include "seed_histogram.h"
+#include "../util/io/input_file.h"
+
+struct DatabaseFile;
+
+// Precomputed reference seed arrays stored next to the database file. The index holds the
+// seed arrays of all shapes for each reference block, so that the search can read them
+// instead of enumerating the seeds of the reference for every query chunk.
+struct SeedIndex
+{
+
+	SeedIndex(const std::string &file_name);
+	~SeedIndex();
+
+	bool has_block(size_t block, const std::vector<uint32_t> &block2db_id) const;
+	Partitioned_histogram histogram(size_t block);
+	void load(size_t block, unsigned shape, const SeedPartitionRange &range, SeedArray::Entry *dst);
+
+	static std::string file_name(const std::string &database);
+	static std::string signature();
+	static void build(DatabaseFile &db_file);
+	static SeedIndex* open(const DatabaseFile &db_file);
+
+	static SeedIndex *instance;
+
+	enum { VERSION = 0 };
+	static constexpr uint64_t MAGIC_NUMBER = 0x4f7c8e1d2a93b65ellu;
+
+private:
+
+	struct Block
+	{
+		uint64_t first_seq, seqs, letters;
+		std::vector<uint64_t> shape_offset;
+	};
+
+	InputFile file_;
+	char hash_[16];
+	std::string signature_;
+	std::vector<Block> blocks_;
+	std::vector<std::vector<uint64_t>> partition_begin_;
+
+};
+
+void build_seed_index();
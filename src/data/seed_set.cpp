@@ -16,23 +16,47 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
+#include <stdio.h>
+#include <string.h>
+#include <sstream>
 #include "seed_set.h"
 #include "../util/ptr_vector.h"
 #include "../util/math/integer.h"
+#include "../util/memory/alignment.h"
+#include "../util/io/mapped_file.h"
+#include "../util/io/output_file.h"
+#include "../util/system/system.h"
+#include "../util/log_stream.h"
 
 No_filter no_filter;
 
+namespace {
+
+struct Seed_set_header
+{
+	uint64_t magic_number;
+	uint32_t version, reserved;
+	uint64_t signature, words;
+	double coverage;
+	char padding[Seed_set::HEADER_SIZE - 40];
+};
+
+static_assert(sizeof(Seed_set_header) == Seed_set::HEADER_SIZE, "Seed set header must fill a cache line.");
+
+}
+
 struct Seed_set_callback
 {
-	Seed_set_callback(vector<bool> &data, size_t max_coverage):
+	Seed_set_callback(uint64_t *data, size_t max_coverage):
 		coverage(0),
 		max_coverage(max_coverage),
-		data(&data)
+		data(data)
 	{}
 	bool operator()(uint64_t seed, uint64_t pos, uint64_t shape)
 	{
-		if ((*data)[seed] == false) {
-			(*data)[seed] = true;
+		const uint64_t bit = 1llu << (seed & 63);
+		if ((data[seed >> 6] & bit) == 0) {
+			data[seed >> 6] |= bit;
 			++coverage;
 			if (coverage > max_coverage)
 				return false;
@@ -42,42 +66,172 @@ struct Seed_set_callback
 	void finish()
 	{}
 	size_t coverage, max_coverage;
-	vector<bool> *data;
+	uint64_t *data;
 };
 
-Seed_set::Seed_set(const Sequence_set &seqs, double max_coverage):
-	data_((size_t)pow(1llu<<Reduction::reduction.bit_size(), shapes[0].length_))
+uint64_t Seed_set::words()
+{
+	return std::max((uint64_t)pow(1llu << Reduction::reduction.bit_size(), shapes[0].length_) / 64, (uint64_t)1);
+}
+
+// Identifies the query sequences and the seed parameters the set was built for.
+uint64_t Seed_set::signature(const Sequence_set &seqs)
+{
+	std::stringstream ss;
+	ss << "shape=" << shapes[0] << ";reduction=" << Reduction::reduction << ";version=" << VERSION;
+	const std::string s = ss.str();
+	uint64_t h = murmur_hash()(seqs.raw_len()), x;
+	for (size_t i = 0; i < s.length(); ++i)
+		h = murmur_hash()(h ^ (uint64_t)(unsigned char)s[i]);
+	const char *p = (const char*)seqs.data(), *end = p + seqs.raw_len();
+	for (; p + 8 <= end; p += 8) {
+		memcpy(&x, p, 8);
+		h = murmur_hash()(h ^ x);
+	}
+	for (; p < end; ++p)
+		h = murmur_hash()(h ^ (uint64_t)(unsigned char)*p);
+	return h;
+}
+
+Seed_set::Seed_set()
+{}
+
+Seed_set::Seed_set(const Sequence_set &seqs, double max_coverage)
 {
 	if (!shapes[0].contiguous())
 		throw std::runtime_error("Contiguous seed required.");
+	const uint64_t n = words();
+	uint64_t *data = (uint64_t*)Util::Memory::aligned_malloc(n * sizeof(uint64_t), 64);
+	memset(data, 0, n * sizeof(uint64_t));
+	data_ = data;
+	const size_t max = size_t(max_coverage*pow(Reduction::reduction.size(), shapes[0].length_));
 	PtrVector<Seed_set_callback> v;
-	v.push_back(new Seed_set_callback(data_, size_t(max_coverage*pow(Reduction::reduction.size(), shapes[0].length_))));
+	v.push_back(new Seed_set_callback(data, max));
 	seqs.enum_seeds(v, seqs.partition(1), 0, 1, &no_filter, true);
 	coverage_ = (double)v.back().coverage / pow(Reduction::reduction.size(), shapes[0].length_);
+	complete_ = v.back().coverage <= max;
+	signature_ = signature(seqs);
+}
+
+Seed_set::~Seed_set()
+{
+	if (!file_)
+		Util::Memory::aligned_free((void*)data_);
 }
 
+void Seed_set::filter(uint64_t *keys, size_t n, uint64_t shape) const
+{
+	filter_seed_bitmap(data_, keys, n);
+}
+
+void Seed_set::save(const std::string &file_name) const
+{
+	Seed_set_header h;
+	memset(&h, 0, sizeof(h));
+	h.magic_number = MAGIC_NUMBER;
+	h.version = VERSION;
+	h.signature = signature_;
+	h.words = words();
+	h.coverage = coverage_;
+	// Another run may have the current file mapped, so it is replaced instead of overwritten.
+	const std::string tmp_name = file_name + ".tmp";
+	OutputFile out(tmp_name);
+	out.write((const char*)&h, sizeof(h));
+	out.write(data_, h.words);
+	out.close();
+	if (rename(tmp_name.c_str(), file_name.c_str()) != 0)
+		throw std::runtime_error("Error renaming file " + tmp_name);
+}
+
+Seed_set* Seed_set::open(const std::string &file_name, const Sequence_set &seqs)
+{
+	if (!exists(file_name))
+		return nullptr;
+	std::unique_ptr<MappedFile> f(new MappedFile(file_name));
+	Seed_set_header h;
+	if (f->size() < sizeof(h))
+		throw std::runtime_error("File is not a DIAMOND seed set: " + file_name);
+	memcpy(&h, f->data(), sizeof(h));
+	if (h.magic_number != MAGIC_NUMBER)
+		throw std::runtime_error("File is not a DIAMOND seed set: " + file_name);
+	if (h.version != VERSION)
+		throw std::runtime_error("Incompatible seed set version: " + file_name);
+	if (h.signature != signature(seqs) || h.words != words()) {
+		log_stream << "Query seed set was built for different sequences or search parameters and will not be used." << endl;
+		return nullptr;
+	}
+	if (f->size() != sizeof(h) + h.words * sizeof(uint64_t))
+		throw std::runtime_error("Unexpected end of file: " + file_name);
+	Seed_set *s = new Seed_set;
+	s->data_ = (const uint64_t*)f->data(sizeof(h));
+	s->coverage_ = h.coverage;
+	s->complete_ = true;
+	s->signature_ = h.signature;
+	s->file_ = std::move(f);
+	return s;
+}
+
+Seed_set* Seed_set::get(const Sequence_set &seqs, double max_coverage, const std::string &file_name)
+{
+	if (!file_name.empty()) {
+		Seed_set *s = open(file_name, seqs);
+		if (s) {
+			log_stream << "Using query seed set from " << file_name << endl;
+			return s;
+		}
+	}
+	Seed_set *s = new Seed_set(seqs, max_coverage);
+	// A set that stopped at the coverage limit is not used for the search and is not saved.
+	if (!file_name.empty() && s->complete_) {
+		try {
+			s->save(file_name);
+		}
+		catch (std::exception &e) {
+			message_stream << "Warning: the query seed set could not be saved (" << e.what() << ")." << endl;
+		}
+	}
+	return s;
+}
+
+const uint32_t Hashed_seed_set::SALT[BLOCK_WORDS] = { 0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u };
+
 struct Hashed_seed_set_callback
 {
-	Hashed_seed_set_callback(PtrVector<PHash_set<Modulo2, No_hash> > &dst):
+	Hashed_seed_set_callback(Hashed_seed_set &dst):
 		dst(dst)
 	{}
 	bool operator()(uint64_t seed, uint64_t pos, uint64_t shape)
 	{
-		dst[shape].insert(seed);
+		dst.insert(seed, shape);
 		return true;
 	}
 	void finish()
 	{}
-	PtrVector<PHash_set<Modulo2, No_hash> > &dst;
+	Hashed_seed_set &dst;
 };
 
 Hashed_seed_set::Hashed_seed_set(const Sequence_set &seqs)
 {
-	for (size_t i = 0; i < shapes.count(); ++i)
-		data_.push_back(new PHash_set<Modulo2, No_hash>(next_power_of_2(seqs.letters()*1.25)));
+	const uint64_t blocks = next_power_of_2(std::max(seqs.letters() * BITS_PER_SEED / (BLOCK_WORDS * 32), (size_t)1));
+	block_mask_ = blocks - 1;
+	for (size_t i = 0; i < shapes.count(); ++i) {
+		Block *b = (Block*)Util::Memory::aligned_malloc(blocks * sizeof(Block), 64);
+		memset(b, 0, blocks * sizeof(Block));
+		data_.push_back(b);
+	}
 	PtrVector<Hashed_seed_set_callback> v;
-	v.push_back(new Hashed_seed_set_callback(data_));
+	v.push_back(new Hashed_seed_set_callback(*this));
 	seqs.enum_seeds(v, seqs.partition(1), 0, shapes.count(), &no_filter);
-	for (size_t i = 0; i < shapes.count(); ++i)
-		log_stream << "Shape=" << i << " Hash_table_size=" << data_[i].size() << " load=" << data_[i].load() << endl;
-}
\ No newline at end of file
+	log_stream << "Bloom_filter_size=" << blocks * sizeof(Block) * shapes.count() << endl;
+}
+
+Hashed_seed_set::~Hashed_seed_set()
+{
+	for (Block *b : data_)
+		Util::Memory::aligned_free(b);
+}
+
+void Hashed_seed_set::filter(uint64_t *keys, size_t n, uint64_t shape) const
+{
+	filter_seed_bloom(data_[shape], block_mask_, keys, n);
+}
@@ -20,35 +20,97 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define SEED_SET_H_
 
 #include <vector>
+#include <memory>
+#include <string>
 #include "sequence_set.h"
-#include "../util/hash_table.h"
-#include "../util/ptr_vector.h"
+#include "../util/hash_function.h"
+#include "../util/simd.h"
 
+struct MappedFile;
+
+// One bit per seed of the (contiguous) seed space, stored in cache line aligned 64 bit words.
 struct Seed_set
 {
+	enum { VERSION = 0, HEADER_SIZE = 64 };
+	static constexpr uint64_t MAGIC_NUMBER = 0x3e8c0d51a7f2b694llu;
+
 	Seed_set(const Sequence_set &seqs, double max_coverage);
+	~Seed_set();
 	bool contains(uint64_t key, uint64_t shape) const
 	{
-		return data_[key];
+		return (data_[key >> 6] >> (key & 63)) & 1;
 	}
+	// Sets the keys of seeds not contained in the set to INVALID_SEED_KEY.
+	void filter(uint64_t *keys, size_t n, uint64_t shape) const;
 	double coverage() const
 	{
 		return coverage_;
 	}
+
+	// Writes the set to a file that can be memory mapped by a later run on the same query sequences.
+	void save(const std::string &file_name) const;
+	// Maps a saved set, returns nullptr if the file does not exist or was built for different sequences or parameters.
+	static Seed_set* open(const std::string &file_name, const Sequence_set &seqs);
+	// Maps the set from file_name if possible, otherwise builds it and saves it there if file_name is not empty.
+	static Seed_set* get(const Sequence_set &seqs, double max_coverage, const std::string &file_name);
+
 private:
-	std::vector<bool> data_;
+
+	Seed_set();
+	Seed_set(const Seed_set&) = delete;
+	Seed_set& operator=(const Seed_set&) = delete;
+	static uint64_t words();
+	static uint64_t signature(const Sequence_set &seqs);
+
+	const uint64_t *data_;
 	double coverage_;
+	// false if the construction stopped at the coverage limit.
+	bool complete_;
+	uint64_t signature_;
+	std::unique_ptr<MappedFile> file_;
 };
 
+// Blocked Bloom filter of the seeds of each shape. A seed sets one bit in each of the 8 words of a 256 bit block,
+// so that a membership test touches a single cache line.
 struct Hashed_seed_set
 {
+	enum { BLOCK_WORDS = 8, BITS_PER_SEED = 16 };
+	typedef uint32_t Block[BLOCK_WORDS];
+
 	Hashed_seed_set(const Sequence_set &seqs);
+	~Hashed_seed_set();
+	void insert(uint64_t key, uint64_t shape)
+	{
+		const uint64_t h = murmur_hash()(key);
+		uint32_t *b = data_[shape][(h >> 32) & block_mask_];
+		for (int i = 0; i < BLOCK_WORDS; ++i)
+			b[i] |= 1u << bit(uint32_t(h), i);
+	}
 	bool contains(uint64_t key, uint64_t shape) const
 	{
-		return data_[shape].contains(key);
+		const uint64_t h = murmur_hash()(key);
+		const uint32_t *b = data_[shape][(h >> 32) & block_mask_];
+		for (int i = 0; i < BLOCK_WORDS; ++i)
+			if ((b[i] & (1u << bit(uint32_t(h), i))) == 0)
+				return false;
+		return true;
 	}
+	void filter(uint64_t *keys, size_t n, uint64_t shape) const;
+
+	static const uint32_t SALT[BLOCK_WORDS];
+
 private:
-	PtrVector<PHash_set<Modulo2, No_hash> > data_;
+
+	static uint32_t bit(uint32_t h, int i)
+	{
+		return (h * SALT[i]) >> 27;
+	}
+
+	std::vector<Block*> data_;
+	uint64_t block_mask_;
 };
 
-#endif
\ No newline at end of file
+DECL_DISPATCH(void, filter_seed_bitmap, (const uint64_t *bitmap, uint64_t *keys, size_t n))
+DECL_DISPATCH(void, filter_seed_bloom, (const Hashed_seed_set::Block *blocks, uint64_t block_mask, uint64_t *keys, size_t n))
+
+#endif
@@ -0,0 +1,69 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include "seed_set.h"
+
+namespace DISPATCH_ARCH {
+
+void filter_seed_bitmap(const uint64_t *bitmap, uint64_t *keys, size_t n)
+{
+	size_t i = 0;
+#ifdef __AVX2__
+	// Gathers the words of 4 keys at once. Lanes holding INVALID_SEED_KEY are not loaded.
+	const __m256i invalid = _mm256_set1_epi64x(INVALID_SEED_KEY), bit_mask = _mm256_set1_epi64x(63), one = _mm256_set1_epi64x(1);
+	for (; i + 4 <= n; i += 4) {
+		const __m256i k = _mm256_loadu_si256((const __m256i*)(keys + i)),
+			valid = _mm256_xor_si256(_mm256_cmpeq_epi64(k, invalid), invalid),
+			w = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), (const long long*)bitmap, _mm256_srli_epi64(k, 6), valid, 8),
+			hit = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srlv_epi64(w, _mm256_and_si256(k, bit_mask)), one), one);
+		_mm256_storeu_si256((__m256i*)(keys + i), _mm256_blendv_epi8(invalid, k, hit));
+	}
+#endif
+	for (; i < n; ++i)
+		if (keys[i] != INVALID_SEED_KEY && ((bitmap[keys[i] >> 6] >> (keys[i] & 63)) & 1) == 0)
+			keys[i] = INVALID_SEED_KEY;
+}
+
+void filter_seed_bloom(const Hashed_seed_set::Block *blocks, uint64_t block_mask, uint64_t *keys, size_t n)
+{
+#ifdef __AVX2__
+	const __m256i salt = _mm256_loadu_si256((const __m256i*)Hashed_seed_set::SALT), one = _mm256_set1_epi32(1);
+#endif
+	for (size_t i = 0; i < n; ++i) {
+		if (keys[i] == INVALID_SEED_KEY)
+			continue;
+		const uint64_t h = murmur_hash()(keys[i]);
+		const uint32_t *b = blocks[(h >> 32) & block_mask];
+#ifdef __AVX2__
+		// One bit in each of the 8 words of the block, all of them have to be set.
+		const __m256i bits = _mm256_sllv_epi32(one, _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)h), salt), 27));
+		if (!_mm256_testc_si256(_mm256_load_si256((const __m256i*)b), bits))
+			keys[i] = INVALID_SEED_KEY;
+#else
+		for (int j = 0; j < Hashed_seed_set::BLOCK_WORDS; ++j)
+			if ((b[j] & (1u << ((uint32_t(h) * Hashed_seed_set::SALT[j]) >> 27))) == 0) {
+				keys[i] = INVALID_SEED_KEY;
+				break;
+			}
+#endif
+	}
+}
+
+}
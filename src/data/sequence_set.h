@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
 #include <queue>
 #include <thread>
+#include <atomic>
 #include "../basic/sequence.h"
 #include "string_set.h"
 #include "../basic/shape_config.h"
@@ -110,12 +111,21 @@ struct Sequence_set : public String_set<Letter, sequence::DELIMITER, 1>
 		return this->letters() / this->get_length();
 	}
 
+	// With minimizer_window > 1, only the window minimizers of the seeds are enumerated (spaced seeds only). With
+	// max_threads > 0, the sequence ranges are processed by at most this many threads.
 	template <typename _f, typename _filter>
-	void enum_seeds(PtrVector<_f> &f, const vector<size_t> &p, size_t shape_begin, size_t shape_end, const _filter *filter, bool contig = false) const
+	void enum_seeds(PtrVector<_f> &f, const vector<size_t> &p, size_t shape_begin, size_t shape_end, const _filter *filter, bool contig = false, size_t minimizer_window = 1, size_t max_threads = 0) const
 	{
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			size_t i;
+			while ((i = next++) < f.size())
+				enum_seeds_worker<_f, _filter>(&f[i], this, (unsigned)p[i], (unsigned)p[i + 1], std::make_pair(shape_begin, shape_end), filter, contig, minimizer_window);
+		};
+		const size_t n = max_threads == 0 ? f.size() : std::min(f.size(), max_threads);
 		std::vector<std::thread> threads;
-		for (unsigned i = 0; i < f.size(); ++i)
-			threads.emplace_back(enum_seeds_worker<_f, _filter>, &f[i], this, (unsigned)p[i], (unsigned)p[i + 1], std::make_pair(shape_begin, shape_end), filter, contig);
+		for (size_t i = 0; i < n; ++i)
+			threads.emplace_back(worker);
 		for (auto &t : threads)
 			t.join();
 	}
@@ -126,23 +136,32 @@ struct Sequence_set : public String_set<Letter, sequence::DELIMITER, 1>
 private:
 
 	template<typename _f, typename _filter>
-	void enum_seeds(_f *f, unsigned begin, unsigned end, pair<size_t, size_t> shape_range, const _filter *filter) const
+	void enum_seeds(_f *f, unsigned begin, unsigned end, pair<size_t, size_t> shape_range, const _filter *filter, size_t minimizer_window) const
 	{
 		vector<Letter> buf(max_len(begin, end));
-		uint64_t key;
+		vector<uint64_t> keys(buf.size()), hashes(minimizer_window > 1 ? buf.size() : 0);
+		vector<uint32_t> queue(hashes.size()), minimizers(hashes.size());
 		for (unsigned i = begin; i < end; ++i) {
 			const sequence seq = (*this)[i];
 			Reduction::reduce_seq(seq, buf);
 			for (size_t shape_id = shape_range.first; shape_id < shape_range.second; ++shape_id) {
 				const Shape& sh = shapes[shape_id];
 				if (seq.length() < sh.length_) continue;
-				Seed_iterator it(buf, sh);
-				size_t j = 0;
-				while (it.good()) {
-					if (it.get(key, sh))
-						if (filter->contains(key, shape_id))
-							(*f)(key, position(i, j), shape_id);
-					++j;
+				const size_t n = seq.length() - sh.length_ + 1;
+				reduced_seed_keys(buf.data(), n, sh, keys.data());
+				if (minimizer_window > 1) {
+					const size_t m = window_minimizers(keys.data(), n, minimizer_window, hashes.data(), queue.data(), minimizers.data());
+					for (size_t k = 0; k < m; ++k) {
+						const uint32_t j = minimizers[k];
+						if (filter->contains(keys[j], shape_id))
+							(*f)(keys[j], position(i, j), shape_id);
+					}
+				}
+				else {
+					filter->filter(keys.data(), n, shape_id);
+					for (size_t j = 0; j < n; ++j)
+						if (keys[j] != INVALID_SEED_KEY)
+							(*f)(keys[j], position(i, j), shape_id);
 				}
 			}
 		}
@@ -176,24 +195,25 @@ private:
 	void enum_seeds_contiguous(_f *f, unsigned begin, unsigned end, const _filter *filter) const
 	{
 		uint64_t key;
+		vector<uint64_t> keys;
 		for (unsigned i = begin; i < end; ++i) {
 			const sequence seq = (*this)[i];
 			if (seq.length() < _it::length()) continue;
 			_it it(seq);
-			size_t j = 0;
-			while (it.good()) {
-				if (it.get(key))
-					if (filter->contains(key, 0))
-						if ((*f)(key, position(i, j), 0) == false)
-							return;
-				++j;
-			}
+			keys.clear();
+			while (it.good())
+				keys.push_back(it.get(key) ? key : INVALID_SEED_KEY);
+			filter->filter(keys.data(), keys.size(), 0);
+			for (size_t j = 0; j < keys.size(); ++j)
+				if (keys[j] != INVALID_SEED_KEY)
+					if ((*f)(keys[j], position(i, j), 0) == false)
+						return;
 		}
 		f->finish();
 	}
 
 	template<typename _f, typename _filter>
-	static void enum_seeds_worker(_f *f, const Sequence_set *seqs, unsigned begin, unsigned end, pair<size_t,size_t> shape_range, const _filter *filter, bool contig)
+	static void enum_seeds_worker(_f *f, const Sequence_set *seqs, unsigned begin, unsigned end, pair<size_t,size_t> shape_range, const _filter *filter, bool contig, size_t minimizer_window)
 	{
 		static const char *errmsg = "Unsupported contiguous seed.";
 		if (shape_range.second - shape_range.first == 1 && shapes[shape_range.first].contiguous() && shapes.count() == 1 && (config.algo == Config::query_indexed || contig)) {
@@ -241,7 +261,7 @@ private:
 			}
 		}
 		else
-			seqs->enum_seeds<_f,_filter>(f, begin, end, shape_range, filter);
+			seqs->enum_seeds<_f,_filter>(f, begin, end, shape_range, filter, minimizer_window);
 	}
 
 };
@@ -252,6 +272,8 @@ struct No_filter
 	{
 		return true;
 	}
+	void filter(uint64_t *keys, size_t n, uint64_t shape) const
+	{}
 };
 
 extern No_filter no_filter;
@@ -34,7 +34,8 @@ struct String_set
 	static const char DELIMITER = _pchar;
 
 	String_set():
-		data_ (PERIMETER_PADDING)
+		data_ (PERIMETER_PADDING),
+		view_(nullptr)
 	{ limits_.push_back(PERIMETER_PADDING); }
 
 	void finish_reserve()
@@ -46,6 +47,14 @@ struct String_set
 		}
 	}
 
+	// Completes the reserved strings as a view of external memory instead of allocating them. data must hold the
+	// strings in the layout produced by finish_reserve, including the perimeter padding, and outlive the set.
+	void finish_reserve(_t *data)
+	{
+		std::vector<_t>().swap(data_);
+		view_ = data;
+	}
+
 	void reserve(size_t n)
 	{
 		limits_.push_back(raw_len() + n + _padding);
@@ -68,10 +77,10 @@ struct String_set
 	}
 
 	_t* ptr(size_t i)
-	{ return &data_[limits_[i]]; }
+	{ return data(limits_[i]); }
 
 	const _t* ptr(size_t i) const
-	{ return &data_[limits_[i]]; }
+	{ return data(limits_[i]); }
 
 	size_t check_idx(size_t i) const
 	{
@@ -93,10 +102,10 @@ struct String_set
 	{ return raw_len() - get_length() - PERIMETER_PADDING; }
 
 	_t* data(uint64_t p = 0)
-	{ return &data_[p]; }
+	{ return (view_ ? view_ : data_.data()) + p; }
 
 	const _t* data(uint64_t p = 0) const
-	{ return &data_[p]; }
+	{ return (view_ ? view_ : data_.data()) + p; }
 
 	size_t position(const _t* p) const
 	{ return p - data(); }
@@ -127,5 +136,6 @@ private:
 
 	std::vector<_t> data_;
 	std::vector<size_t> limits_;
+	_t *view_;
 
 };
@@ -0,0 +1,106 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <algorithm>
+#include "subject_index.h"
+#include "../basic/config.h"
+#include "../basic/shape_config.h"
+#include "../util/math/integer.h"
+#include "../util/log_stream.h"
+#include "../util/util.h"
+
+using std::vector;
+using std::pair;
+using std::endl;
+
+struct SubjectIndexCallback
+{
+	SubjectIndexCallback(vector<pair<uint64_t, uint64_t>> &out):
+		out(out)
+	{}
+	bool operator()(uint64_t seed, uint64_t pos, uint64_t shape)
+	{
+		out.emplace_back(seed, pos);
+		return true;
+	}
+	void finish()
+	{}
+	vector<pair<uint64_t, uint64_t>> &out;
+};
+
+SubjectIndex::SubjectIndex(const Sequence_set &seqs)
+{
+	const vector<size_t> p = seqs.partition(config.threads_);
+	for (unsigned sid = 0; sid < shapes.count(); ++sid) {
+		vector<vector<pair<uint64_t, uint64_t>>> seeds(p.size() - 1);
+		PtrVector<SubjectIndexCallback> cb;
+		for (size_t i = 0; i < p.size() - 1; ++i)
+			cb.push_back(new SubjectIndexCallback(seeds[i]));
+		seqs.enum_seeds(cb, p, sid, sid + 1, &no_filter);
+
+		vector<pair<uint64_t, uint64_t>> &v = seeds.front();
+		for (size_t i = 1; i < seeds.size(); ++i) {
+			v.insert(v.end(), seeds[i].begin(), seeds[i].end());
+			vector<pair<uint64_t, uint64_t>>().swap(seeds[i]);
+		}
+		std::sort(v.begin(), v.end());
+		if (v.size() > UINT32_MAX)
+			throw std::runtime_error("Reference block too large for the subject-indexed algorithm.");
+
+		size_t groups = 0;
+		for (size_t i = 0; i < v.size(); ++i)
+			if (i == 0 || v[i].first != v[i - 1].first)
+				++groups;
+		const size_t size = next_power_of_2(std::max(groups * 1.5, 2.0));
+
+		ShapeIndex *s = new ShapeIndex;
+		s->table.reset(new Table(size, Hash(size - 1)));
+		s->pos.reserve(v.size());
+		Sd sd;
+		for (size_t i = 0; i < v.size();) {
+			size_t j = i;
+			while (j < v.size() && v[j].first == v[i].first)
+				s->pos.push_back(Packed_loc(v[j++].second));
+			Table::Entry *e = s->table->insert(v[i].first);
+			e->begin = (uint32_t)i;
+			e->count = (uint32_t)(j - i);
+			sd.add((double)(j - i));
+			i = j;
+		}
+		s->cap = groups > 1 ? (uint32_t)(sd.mean() + config.freq_sd * sd.sd()) : UINT32_MAX;
+		log_stream << "Subject index shape=" << sid << " seeds=" << v.size() << " groups=" << groups << " mean=" << sd.mean() << " SD=" << sd.sd() << " cap=" << s->cap << endl;
+		shapes_.emplace_back(s);
+	}
+}
+
+size_t SubjectIndex::mem_estimate(size_t letters)
+{
+	// The hash table has between 1.5 and 3 entries per seed group.
+	return shapes.count() * letters * (sizeof(Packed_loc) + 2 * sizeof(Table::Entry))
+		+ letters * 2 * sizeof(pair<uint64_t, uint64_t>);
+}
+
+size_t SubjectIndex::mem_size() const
+{
+	size_t n = 0;
+	for (const std::unique_ptr<ShapeIndex> &s : shapes_)
+		n += s->pos.size() * sizeof(Packed_loc) + s->table->size() * sizeof(Table::Entry);
+	return n;
+}
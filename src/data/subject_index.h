@@ -0,0 +1,98 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "sequence_set.h"
+#include "../basic/packed_loc.h"
+#include "../util/hash_function.h"
+#include "../util/data_structures/hash_table.h"
+
+// Seed index of a reference block for the subject-indexed algorithm. For every shape, the positions of the
+// reference seeds are stored grouped by seed, and a hash table maps the seeds to their groups. The index is built
+// once per reference block and kept with the block, the query seeds are looked up in it directly.
+struct SubjectIndex
+{
+
+	SubjectIndex(const Sequence_set &seqs);
+
+	// Returns the reference positions of the seed and sets n to their number, or returns nullptr if the seed does
+	// not occur in the reference.
+	const Packed_loc* find(unsigned shape, uint64_t key, size_t &n) const
+	{
+		const ShapeIndex &s = *shapes_[shape];
+		const Table::Entry *e = s.table->find_entry(key);
+		if (e == nullptr) {
+			n = 0;
+			return nullptr;
+		}
+		n = e->count;
+		return s.pos.data() + e->begin;
+	}
+
+	// Seeds occurring more often than this in the reference are frequent and are not searched. The cap is the mean
+	// plus config.freq_sd standard deviations of the group sizes of all seeds of the reference block. The
+	// double-indexed algorithm computes it over the seeds that occur in both the query chunk and the reference block
+	// and also masks seeds that are frequent in the query chunk, so the two algorithms can mask different seeds and
+	// report slightly different hits.
+	uint32_t cap(unsigned shape) const
+	{
+		return shapes_[shape]->cap;
+	}
+
+	size_t mem_size() const;
+	// Estimated peak memory of building the index for a reference of this size with the current shapes: the index
+	// of all shapes plus the sorted seed list of one shape.
+	static size_t mem_estimate(size_t letters);
+
+private:
+
+	struct Group {
+		operator unsigned() const
+		{
+			return count;
+		}
+		uint32_t begin, count;
+	};
+
+	struct Hash {
+		Hash(uint64_t mask):
+			mask(mask)
+		{}
+		uint64_t operator()(uint64_t key) const
+		{
+			return murmur_hash()(key) & mask;
+		}
+		uint64_t mask;
+	};
+
+	typedef HashTable<uint64_t, Group, Hash> Table;
+
+	struct ShapeIndex {
+		std::unique_ptr<Table> table;
+		std::vector<Packed_loc> pos;
+		uint32_t cap;
+	};
+
+	std::vector<std::unique_ptr<ShapeIndex>> shapes_;
+
+};
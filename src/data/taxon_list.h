@@ -23,6 +23,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../util/io/file_backed_buffer.h"
 #include "../util/data_structures/compact_array.h"
 
+// A range [begin, end) of database sequences whose taxa all lie below the top level taxon taxon_id. Sequences
+// that are unclassified or assigned to several top level taxa form ranges with taxon_id 0.
+struct TaxonRange
+{
+	uint64_t begin, end;
+	unsigned taxon_id;
+};
+
 struct TaxonList : public CompactArray<vector<unsigned> >
 {
 	TaxonList(Deserializer &in, size_t size, size_t data_size);
@@ -128,5 +128,5 @@ extern Taxonomy taxonomy;
 
 struct TaxonomyFilter : public BitVector
 {
-	TaxonomyFilter(const std::string &include, const std::string &exclude, const TaxonList &list, TaxonomyNodes &nodes);
+	TaxonomyFilter(const std::string &include, const std::string &exclude, const TaxonList &list, TaxonomyNodes &nodes, const std::vector<TaxonRange> &ranges = std::vector<TaxonRange>());
 };
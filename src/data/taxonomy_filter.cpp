@@ -1,8 +1,22 @@
 #include "taxonomy.h"
+#include "../util/log_stream.h"
 
 using std::string;
+using std::vector;
 
-TaxonomyFilter::TaxonomyFilter(const string &include, const string &exclude, const TaxonList &list, TaxonomyNodes &nodes):
+// Returns false if the filter rejects all sequences of a range, which is the case if the top level taxon of the
+// range lies inside an excluded subtree, or if no taxon of an include list is related to it.
+static bool range_candidate(const TaxonRange &r, const std::set<unsigned> &filter, bool exclude, const TaxonomyNodes &nodes)
+{
+	if (r.taxon_id == 0)
+		return true;
+	for (unsigned t : filter)
+		if (exclude ? nodes.is_ancestor(t, r.taxon_id) : (nodes.is_ancestor(t, r.taxon_id) || nodes.is_ancestor(r.taxon_id, t)))
+			return !exclude;
+	return exclude;
+}
+
+TaxonomyFilter::TaxonomyFilter(const string &include, const string &exclude, const TaxonList &list, TaxonomyNodes &nodes, const vector<TaxonRange> &ranges):
 	BitVector(list.size())
 {
 	if (!include.empty() && !exclude.empty())
@@ -13,7 +27,21 @@ TaxonomyFilter::TaxonomyFilter(const string &include, const string &exclude, con
 		throw std::runtime_error("Option --taxonlist/--taxon-exclude used with empty list.");
 	if (taxon_filter_list.find(1) != taxon_filter_list.end() || taxon_filter_list.find(0) != taxon_filter_list.end())
 		throw std::runtime_error("Option --taxonlist/--taxon-exclude used with invalid argument (0 or 1).");
-	for (size_t i = 0; i < list.size(); ++i)
-		if (nodes.contained(list[i], taxon_filter_list) ^ e)
-			set(i);
+	if (ranges.empty()) {
+		for (size_t i = 0; i < list.size(); ++i)
+			if (nodes.contained(list[i], taxon_filter_list) ^ e)
+				set(i);
+		return;
+	}
+	size_t skipped = 0;
+	for (const TaxonRange &r : ranges) {
+		if (!range_candidate(r, taxon_filter_list, e, nodes)) {
+			skipped += r.end - r.begin;
+			continue;
+		}
+		for (size_t i = r.begin; i < r.end; ++i)
+			if (nodes.contained(list[i], taxon_filter_list) ^ e)
+				set(i);
+	}
+	log_stream << "Taxonomy filter skipped " << skipped << " sequences by taxon range." << std::endl;
 }
\ No newline at end of file
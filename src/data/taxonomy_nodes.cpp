@@ -58,6 +58,13 @@ TaxonomyNodes::TaxonomyNodes(Deserializer &in, uint32_t db_build)
 	contained_.insert(contained_.end(), parent_.size(), false);
 }
 
+TaxonomyNodes::TaxonomyNodes(const Taxonomy &taxonomy):
+	parent_(taxonomy.parent_.begin(), taxonomy.parent_.end()),
+	rank_(taxonomy.rank_),
+	cached_(parent_.size(), false),
+	contained_(parent_.size(), false)
+{}
+
 unsigned TaxonomyNodes::get_lca(unsigned t1, unsigned t2) const
 {
 	static const int max = 64;
@@ -91,6 +98,21 @@ unsigned TaxonomyNodes::get_lca(unsigned t1, unsigned t2) const
 	return p;
 }
 
+// Returns true if ancestor is taxid itself or lies on its path to the root.
+bool TaxonomyNodes::is_ancestor(unsigned ancestor, unsigned taxid) const
+{
+	static const int max = 64;
+	int n = 0;
+	while (taxid != ancestor) {
+		if (taxid <= 1 || taxid >= parent_.size())
+			return false;
+		taxid = parent_[taxid];
+		if (++n > max)
+			throw std::runtime_error("Path in taxonomy too long (5).");
+	}
+	return true;
+}
+
 bool TaxonomyNodes::contained(unsigned query, const set<unsigned> &filter)
 {
 	static const int max = 64;
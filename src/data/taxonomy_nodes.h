@@ -56,10 +56,13 @@ private:
 	static std::map<std::string, Rank> init_map();
 };
 
+struct Taxonomy;
+
 struct TaxonomyNodes
 {
 
 	TaxonomyNodes(Deserializer &in, uint32_t db_build);
+	explicit TaxonomyNodes(const Taxonomy &taxonomy);
 	static void build(Serializer &out);
 	unsigned get_parent(unsigned taxid) const
 	{
@@ -70,6 +73,7 @@ struct TaxonomyNodes
 	unsigned rank_taxid(unsigned taxid, Rank rank) const;
 	std::set<unsigned> rank_taxid(const std::vector<unsigned> &taxid, Rank rank) const;
 	unsigned get_lca(unsigned t1, unsigned t2) const;
+	bool is_ancestor(unsigned ancestor, unsigned taxid) const;
 	bool contained(unsigned query, const std::set<unsigned> &filter);
 	bool contained(const std::vector<unsigned> query, const std::set<unsigned> &filter);
 
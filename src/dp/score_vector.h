@@ -320,7 +320,9 @@ static inline int32_t load_sv(const int32_t *x) {
 template<typename _t, typename _p>
 static inline void store_sv(const DISPATCH_ARCH::score_vector<_t> &sv, _p *dst)
 {
-#if ARCH_ID == 2
+#if ARCH_ID == 3
+	_mm512_storeu_si512((void*)dst, sv.data_);
+#elif ARCH_ID == 2
 	_mm256_storeu_si256((__m256i*)dst, sv.data_);
 #else
 	_mm_storeu_si128((__m128i*)dst, sv.data_);
@@ -21,7 +21,186 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace DISPATCH_ARCH {
 
-#if ARCH_ID == 2
+#if ARCH_ID == 3
+
+template<>
+struct score_vector<int8_t>
+{
+
+	score_vector() :
+		data_(_mm512_set1_epi8(SCHAR_MIN))
+	{}
+
+	explicit score_vector(__m512i data) :
+		data_(data)
+	{}
+
+	explicit score_vector(int8_t x) :
+		data_(_mm512_set1_epi8(x))
+	{}
+
+	explicit score_vector(int x) :
+		data_(_mm512_set1_epi8(x))
+	{}
+
+	explicit score_vector(const int8_t* s) :
+		data_(_mm512_loadu_si512((const void*)s))
+	{ }
+
+	explicit score_vector(const uint8_t* s) :
+		data_(_mm512_loadu_si512((const void*)s))
+	{ }
+
+	score_vector(unsigned a, __m512i seq)
+	{
+		// The shuffles work within 128 bit lanes, so the 32 byte profile rows are replicated to all four lanes.
+		const __m512i r1 = _mm512_broadcast_i64x4(_mm256_load_si256(reinterpret_cast<const __m256i*>(&score_matrix.matrix8_low()[a << 5])));
+		const __m512i r2 = _mm512_broadcast_i64x4(_mm256_load_si256(reinterpret_cast<const __m256i*>(&score_matrix.matrix8_high()[a << 5])));
+
+		__m512i high_mask = _mm512_slli_epi16(_mm512_and_si512(seq, _mm512_set1_epi8('\x10')), 3);
+		__m512i seq_low = _mm512_or_si512(seq, high_mask);
+		__m512i seq_high = _mm512_or_si512(seq, _mm512_xor_si512(high_mask, _mm512_set1_epi8('\x80')));
+
+		__m512i s1 = _mm512_shuffle_epi8(r1, seq_low);
+		__m512i s2 = _mm512_shuffle_epi8(r2, seq_high);
+		data_ = _mm512_or_si512(s1, s2);
+	}
+
+	score_vector operator+(const score_vector& rhs) const
+	{
+		return score_vector(_mm512_adds_epi8(data_, rhs.data_));
+	}
+
+	score_vector operator-(const score_vector& rhs) const
+	{
+		return score_vector(_mm512_subs_epi8(data_, rhs.data_));
+	}
+
+	score_vector& operator+=(const score_vector& rhs) {
+		data_ = _mm512_adds_epi8(data_, rhs.data_);
+		return *this;
+	}
+
+	score_vector& operator-=(const score_vector& rhs)
+	{
+		data_ = _mm512_subs_epi8(data_, rhs.data_);
+		return *this;
+	}
+
+	score_vector& operator &=(const score_vector& rhs) {
+		data_ = _mm512_and_si512(data_, rhs.data_);
+		return *this;
+	}
+
+	score_vector& operator++() {
+		data_ = _mm512_adds_epi8(data_, _mm512_set1_epi8(1));
+		return *this;
+	}
+
+	friend score_vector blend(const score_vector &v, const score_vector &w, const score_vector &mask) {
+		return score_vector(_mm512_mask_blend_epi8(_mm512_movepi8_mask(mask.data_), v.data_, w.data_));
+	}
+
+	score_vector operator==(const score_vector &v) const {
+		return score_vector(_mm512_movm_epi8(_mm512_cmpeq_epi8_mask(data_, v.data_)));
+	}
+
+	friend FORCE_INLINE uint64_t cmp_mask(const score_vector &v, const score_vector &w) {
+		return (uint64_t)_mm512_cmpeq_epi8_mask(v.data_, w.data_);
+	}
+
+	int operator [](unsigned i) const
+	{
+		return *(((uint8_t*)&data_) + i);
+	}
+
+	void set(unsigned i, uint8_t v)
+	{
+		*(((uint8_t*)&data_) + i) = v;
+	}
+
+	score_vector& max(const score_vector& rhs)
+	{
+		data_ = _mm512_max_epi8(data_, rhs.data_);
+		return *this;
+	}
+
+	score_vector& min(const score_vector& rhs)
+	{
+		data_ = _mm512_min_epi8(data_, rhs.data_);
+		return *this;
+	}
+
+	friend score_vector max(const score_vector& lhs, const score_vector& rhs)
+	{
+		return score_vector(_mm512_max_epi8(lhs.data_, rhs.data_));
+	}
+
+	friend score_vector min(const score_vector& lhs, const score_vector& rhs)
+	{
+		return score_vector(_mm512_min_epi8(lhs.data_, rhs.data_));
+	}
+
+	void store(int8_t* ptr) const
+	{
+		_mm512_storeu_si512((void*)ptr, data_);
+	}
+
+	friend std::ostream& operator<<(std::ostream& s, score_vector v)
+	{
+		int8_t x[64];
+		v.store(x);
+		for (unsigned i = 0; i < 64; ++i)
+			printf("%3i ", (int)x[i]);
+		return s;
+	}
+
+	__m512i data_;
+
+};
+
+template<>
+struct ScoreTraits<score_vector<int8_t>>
+{
+	enum { CHANNELS = 64 };
+	typedef ::DISPATCH_ARCH::SIMD::Vector<int8_t> Vector;
+	typedef int8_t Score;
+	typedef uint8_t Unsigned;
+	typedef uint64_t Mask;
+	// The vertical and horizontal masks of 64 channels take 128 bits.
+	struct TraceMask {
+		static FORCE_INLINE unsigned __int128 make(uint64_t vmask, uint64_t hmask) {
+			return (unsigned __int128)vmask << 64 | (unsigned __int128)hmask;
+		}
+		static unsigned __int128 vmask(int channel) {
+			return (unsigned __int128)1 << (channel + 64);
+		}
+		static unsigned __int128 hmask(int channel) {
+			return (unsigned __int128)1 << channel;
+		}
+		unsigned __int128 gap;
+		unsigned __int128 open;
+	};
+	static score_vector<int8_t> zero() {
+		return score_vector<int8_t>();
+	}
+	static constexpr int8_t max_score() {
+		return SCHAR_MAX;
+	}
+	static int int_score(int8_t s)
+	{
+		return (int)s - SCHAR_MIN;
+	}
+	static constexpr int max_int_score() {
+		return SCHAR_MAX - SCHAR_MIN;
+	}
+	static constexpr int8_t zero_score() {
+		return SCHAR_MIN;
+	}
+	static void saturate(score_vector<int8_t>& v) {}
+};
+
+#elif ARCH_ID == 2
 
 template<>
 struct score_vector<int8_t>
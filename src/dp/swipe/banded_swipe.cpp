@@ -790,7 +790,7 @@ list<Hsp> swipe(
 	}
 
 	list<Hsp> out;
-	int realign = 0;
+	uint64_t realign = 0;
 	task_timer timer;
 	for (int i = 0; i < targets.n_targets; ++i) {
 		if (best[i] < ScoreTraits<_sv>::max_score()) {
@@ -798,7 +798,7 @@ list<Hsp> swipe(
 				out.push_back(traceback<_sv>(query, frame, composition_bias, dp, subject_begin[i], d_begin[i], best[i], max_col[i], i, i0 - j, i1 - j, max_band_row[i]));
 				if ((config.max_hsps == 0 || config.max_hsps > 1) && !config.no_swipe_realign
 					&& ::DP::BandedSwipe::DISPATCH_ARCH::realign<_traceback>(out.back(), subject_begin[i]))
-					realign |= 1 << i;
+					realign |= uint64_t(1) << i;
 			}
 		}
 		else
@@ -811,7 +811,7 @@ list<Hsp> swipe(
 		vector<vector<Letter>> seqs;
 		vector<DpTarget> realign_targets;
 		for (int i = 0; i < targets.n_targets; ++i) {
-			if ((realign & (1 << i)) == 0)
+			if ((realign & (uint64_t(1) << i)) == 0)
 				continue;
 			seqs.push_back(subject_begin[i].seq.copy());
 			realign_targets.push_back(subject_begin[i]);
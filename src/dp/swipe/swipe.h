@@ -138,7 +138,7 @@ struct CBSBuffer<_sv, const int8_t*> {
 	_sv operator()(int i) const {
 		return data[i];
 	}
-	std::vector<_sv, Util::Memory::AlignmentAllocator<_sv, 32>> data;
+	std::vector<_sv, Util::Memory::AlignmentAllocator<_sv, (alignof(_sv) > 32 ? alignof(_sv) : 32)>> data;
 };
 
 
@@ -74,7 +74,14 @@ void window_ungapped_best(const Letter* query, const Letter** subjects, int subj
 #ifdef __SSE4_1__
 	}
 #endif
-#if ARCH_ID == 2
+#if ARCH_ID == 3
+	else if (subject_count <= 16)
+		::DP::ARCH_SSE4_1::window_ungapped(query, subjects, subject_count, window, out);
+	else if (subject_count <= 32)
+		::DP::ARCH_AVX2::window_ungapped(query, subjects, subject_count, window, out);
+	else
+		window_ungapped(query, subjects, subject_count, window, out);
+#elif ARCH_ID == 2
 	else if (subject_count <= 16)
 		::DP::ARCH_SSE4_1::window_ungapped(query, subjects, subject_count, window, out);
 	else
@@ -28,6 +28,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include <algorithm>
 #include <cstdio>
+#include <future>
+#include <functional>
 #include "../data/reference.h"
 #include "../data/queries.h"
 #include "../basic/statistics.h"
@@ -40,6 +42,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../data/taxonomy.h"
 #include "../basic/masking.h"
 #include "../data/ref_dictionary.h"
+#include "../data/seed_index.h"
+#include "../data/seed_frequency.h"
+#include "../data/subject_index.h"
 #include "../data/metadata.h"
 #include "../search/search.h"
 #include "workflow.h"
@@ -77,23 +82,149 @@ string get_ref_block_tmpfile_name(size_t query, size_t block) {
 	return join_path(config.parallel_tmpdir, file_name);
 }
 
+// A loaded reference block. Masking, histograms and the subject index are recorded once computed so that blocks
+// loaded ahead of their search or kept across query chunks can skip these steps.
+struct RefBlock
+{
+	RefBlock():
+		seqs(nullptr),
+		ids(nullptr),
+		masked(false),
+		masked_letters(0),
+		blocked(false),
+		hst_built(false)
+	{}
+	~RefBlock()
+	{
+		delete seqs;
+		delete ids;
+	}
+	// Memory held by the block, including the data computed for its search.
+	size_t mem_size() const
+	{
+		size_t n = block2db_id.size() * sizeof(uint32_t);
+		if (seqs)
+			n += seqs->raw_len() * sizeof(Letter) + seqs->get_length() * sizeof(size_t);
+		if (ids)
+			n += ids->raw_len() + ids->get_length() * sizeof(size_t);
+		if (hst_built)
+			n += shapes.count() * (hst.partition().size() - 1) * Const::seedp * sizeof(unsigned);
+		if (subject_index)
+			n += subject_index->mem_size();
+		return n;
+	}
+	vector<uint32_t> block2db_id;
+	Sequence_set *seqs;
+	String_set<char, 0> *ids;
+	bool masked;
+	size_t masked_letters;
+	// The block covers only part of the database, applied to blocked_processing when the block is searched.
+	bool blocked;
+	bool hst_built;
+	Partitioned_histogram hst;
+	unique_ptr<SubjectIndex> subject_index;
+};
+
+static SeedIndex* ref_index(size_t block, const vector<uint32_t> &block2db_id)
+{
+	return SeedIndex::instance && config.algo == Config::double_indexed && query_seeds_hashed == 0
+		&& SeedIndex::instance->has_block(block, block2db_id) ? SeedIndex::instance : nullptr;
+}
+
+// Reference blocks kept in memory across query chunks, filled during the first query chunk.
+static PtrVector<RefBlock> ref_block_cache;
+
+// Histograms built without a query filter do not depend on the query chunk.
+static bool ref_histogram_reusable()
+{
+	return config.algo != Config::query_indexed && query_seeds_hashed == 0;
+}
+
+static Partitioned_histogram ref_histogram(const Sequence_set &seqs)
+{
+	if (config.algo == Config::query_indexed)
+		return Partitioned_histogram(seqs, false, query_seeds);
+	else if (query_seeds_hashed != 0)
+		return Partitioned_histogram(seqs, true, query_seeds_hashed);
+	else
+		return Partitioned_histogram(seqs, false, &no_filter, config.minimizer_window);
+}
+
+// Loads the next reference block. With prepare set, as used for the background prefetch, masking and histograms
+// are computed as well so that the search of the block can start right away.
+static RefBlock* load_ref_block(DatabaseFile &db_file, const BitVector *filter, size_t block, bool prepare)
+{
+	unique_ptr<RefBlock> b(new RefBlock);
+	if (!db_file.load_seqs(&b->block2db_id, (size_t)(config.chunk_size*1e9), &b->seqs, &b->ids, true, filter, true, Chunk(), prepare ? 3 : 1, &b->blocked))
+		return nullptr;
+	if (!prepare)
+		return b.release();
+	if (config.masking == 1 && !config.no_ref_masking && !db_file.apply_stored_masks) {
+		b->masked_letters = mask_seqs(*b->seqs, Masking::get());
+		b->masked = true;
+	}
+	if (config.swipe_all)
+		return b.release();
+	if (config.algo == Config::subject_indexed)
+		b->subject_index.reset(new SubjectIndex(*b->seqs));
+	else if (!ref_index(block, b->block2db_id)) {
+		b->hst = ref_histogram(*b->seqs);
+		b->hst_built = true;
+	}
+	return b.release();
+}
+
+// Prefetching keeps a second block resident: its sequences and ids (about 2 bytes per letter) and histograms,
+// on top of the estimated peak memory of searching one block (20 bytes per letter divided by the index chunks).
+static bool use_prefetch()
+{
+	if (config.no_prefetch)
+		return false;
+	const double ram = total_ram();
+	return ram == 0.0 || ram >= config.chunk_size * (20.0 / config.lowmem + 2.0);
+}
+
+// Caching keeps the blocks searched for the first query chunk resident for the following query chunks. The memory
+// budget is the memory available before the first block is loaded. The returned budget is 0 if the cache is not used.
+static size_t block_cache_budget(bool last_query_chunk)
+{
+	if (config.no_block_cache || config.multiprocessing || last_query_chunk)
+		return 0;
+	return (size_t)(available_ram() * 1e9);
+}
+
+static void set_ref_block(const RefBlock &b)
+{
+	block_to_database_id = b.block2db_id;
+	ref_seqs::data_ = b.seqs;
+	ref_ids::data_ = b.ids;
+	blocked_processing = b.blocked;
+}
+
 void run_ref_chunk(DatabaseFile &db_file,
 	unsigned query_chunk,
 	pair<size_t, size_t> query_len_bounds,
-	char *query_buffer,
 	Consumer &master_out,
 	PtrVector<TempFile> &tmp_file,
 	const Parameters &params,
-	const Metadata &metadata)
+	const Metadata &metadata,
+	RefBlock *ref_block = nullptr,
+	const std::function<void()> &before_align = std::function<void()>())
 {
 	log_rss();
 
 	task_timer timer;
-	if (config.masking == 1 && !config.no_ref_masking) {
+	if (ref_block && ref_block->masked)
+		log_stream << "Masked letters: " << ref_block->masked_letters << endl;
+	else if (config.masking == 1 && !config.no_ref_masking && !db_file.apply_stored_masks) {
 		timer.go("Masking reference");
 		size_t n = mask_seqs(*ref_seqs::data_, Masking::get());
 		timer.finish();
 		log_stream << "Masked letters: " << n << endl;
+		if (ref_block) {
+			ref_block->masked = true;
+			ref_block->masked_letters = n;
+		}
 	}
 
 	ReferenceDictionary::get().init(safe_cast<unsigned>(ref_seqs::get().get_length()), block_to_database_id);
@@ -103,24 +234,55 @@ void run_ref_chunk(DatabaseFile &db_file,
 		config.tmpdir,
 		config.query_bins);
 
-	if (!config.swipe_all) {
-		timer.go("Building reference histograms");
-		if (config.algo == Config::query_indexed)
-			ref_hst = Partitioned_histogram(*ref_seqs::data_, false, query_seeds);
-		else if (query_seeds_hashed != 0)
-			ref_hst = Partitioned_histogram(*ref_seqs::data_, true, query_seeds_hashed);
-		else
-			ref_hst = Partitioned_histogram(*ref_seqs::data_, false, &no_filter);
+	if (!config.swipe_all && config.algo == Config::subject_indexed) {
+		unique_ptr<SubjectIndex> local_index;
+		SubjectIndex *index = ref_block ? ref_block->subject_index.get() : nullptr;
+		if (!index) {
+			timer.go("Building subject index");
+			index = new SubjectIndex(*ref_seqs::data_);
+			if (ref_block)
+				ref_block->subject_index.reset(index);
+			else
+				local_index.reset(index);
+			timer.finish();
+			log_stream << "Subject index size = " << index->mem_size() << endl;
+		}
+		timer.finish();
+
+		for (unsigned i = 0; i < shapes.count(); ++i)
+			search_shape(i, query_chunk, params, *index);
+
+		timer.go("Clearing query masking");
+		Frequent_seeds::clear_masking(*query_seqs::data_);
+	}
+	else if (!config.swipe_all) {
+		SeedIndex *index = ref_index(current_ref_block, block_to_database_id);
+		if (index) {
+			timer.go("Loading reference histograms");
+			ref_hst = index->histogram(current_ref_block);
+		}
+		else if (ref_block && ref_block->hst_built) {
+			ref_hst = std::move(ref_block->hst);
+			ref_block->hst_built = false;
+		}
+		else {
+			timer.go("Building reference histograms");
+			ref_hst = ref_histogram(*ref_seqs::data_);
+		}
 
 		timer.go("Allocating buffers");
 		char *ref_buffer = SeedArray::alloc_buffer(ref_hst);
 		timer.finish();
 
 		for (unsigned i = 0; i < shapes.count(); ++i)
-			search_shape(i, query_chunk, query_buffer, ref_buffer, params);
+			search_shape(i, query_chunk, ref_buffer, params, index);
 
 		timer.go("Deallocating buffers");
 		delete[] ref_buffer;
+		if (ref_block && !index && ref_histogram_reusable()) {
+			ref_block->hst = std::move(ref_hst);
+			ref_block->hst_built = true;
+		}
 
 		timer.go("Clearing query masking");
 		Frequent_seeds::clear_masking(*query_seqs::data_);
@@ -140,6 +302,11 @@ void run_ref_chunk(DatabaseFile &db_file,
 	else
 		out = &master_out;
 
+	if (before_align) {
+		timer.finish();
+		before_align();
+	}
+
 	timer.go("Computing alignments");
 	align_queries(*Trace_pt_buffer::instance, out, params, metadata);
 	delete Trace_pt_buffer::instance;
@@ -147,9 +314,11 @@ void run_ref_chunk(DatabaseFile &db_file,
 	if (blocked_processing)
 		IntermediateRecord::finish_file(*out);
 
-	timer.go("Deallocating reference");
-	delete ref_seqs::data_;
-	delete ref_ids::data_;
+	if (!ref_block) {
+		timer.go("Deallocating reference");
+		delete ref_seqs::data_;
+		delete ref_ids::data_;
+	}
 	timer.finish();
 }
 
@@ -160,8 +329,17 @@ void deallocate_queries() {
 	delete query_qual;
 }
 
+// Query chunks after the first one get their own seed set file.
+static string query_seed_set_file(unsigned query_chunk)
+{
+	if (config.query_seed_set.empty() || query_chunk == 0)
+		return config.query_seed_set;
+	return config.query_seed_set + '.' + std::to_string(query_chunk);
+}
+
 void run_query_chunk(DatabaseFile &db_file,
 	unsigned query_chunk,
+	bool last_query_chunk,
 	Consumer &master_out,
 	OutputFile *unaligned_file,
 	OutputFile *aligned_file,
@@ -182,11 +360,14 @@ void run_query_chunk(DatabaseFile &db_file,
 	if (query_chunk == 0)
 		setup_search_cont();
 	if (config.algo == -1) {
-		if (config.sensitivity >= Sensitivity::VERY_SENSITIVE || config.sensitivity == Sensitivity::MID_SENSITIVE) {
+		if (config.minimizer_window <= 1 && config.sensitivity < Sensitivity::VERY_SENSITIVE && config.sensitivity != Sensitivity::MID_SENSITIVE
+			&& use_subject_indexed(query_seqs::get().letters(), db_file.ref_header.letters))
+			config.algo = Config::subject_indexed;
+		else if (config.sensitivity >= Sensitivity::VERY_SENSITIVE || config.sensitivity == Sensitivity::MID_SENSITIVE || config.minimizer_window > 1) {
 			config.algo = Config::double_indexed;
 		}
 		else {
-			query_seeds = new Seed_set(query_seqs::get(), SINGLE_INDEXED_SEED_SPACE_MAX_COVERAGE);
+			query_seeds = Seed_set::get(query_seqs::get(), SINGLE_INDEXED_SEED_SPACE_MAX_COVERAGE, query_seed_set_file(query_chunk));
 			timer.finish();
 			log_stream << "Seed space coverage = " << query_seeds->coverage() << endl;
 			if (use_single_indexed(query_seeds->coverage(), query_seqs::get().letters(), db_file.ref_header.letters))
@@ -201,32 +382,38 @@ void run_query_chunk(DatabaseFile &db_file,
 	else if (config.algo == Config::query_indexed) {
 		if (config.sensitivity >= Sensitivity::VERY_SENSITIVE)
 			throw std::runtime_error("Query-indexed algorithm not available for this sensitivity setting.");
-		query_seeds = new Seed_set(query_seqs::get(), 2);
+		if (config.minimizer_window > 1)
+			throw std::runtime_error("Query-indexed algorithm not available with --minimizer-window.");
+		query_seeds = Seed_set::get(query_seqs::get(), 2, query_seed_set_file(query_chunk));
 		timer.finish();
 		log_stream << "Seed space coverage = " << query_seeds->coverage() << endl;
 	}
+	else if (config.algo == Config::subject_indexed && config.minimizer_window > 1)
+		throw std::runtime_error("Subject-indexed algorithm not available with --minimizer-window.");
 	else
 		timer.finish();
-	if (query_chunk == 0)
+	if (query_chunk == 0) {
 		setup_search();
+		setup_finger_print(query_seqs::get());
+		if (config.algo == Config::double_indexed && !config.swipe_all && !config.multiprocessing)
+			SeedIndex::instance = SeedIndex::open(db_file);
+		if (config.global_freq && config.algo == Config::double_indexed && !config.swipe_all)
+			SeedFrequency::instance = SeedFrequency::get(db_file);
+		if (config.masking == 1 && !config.no_ref_masking) {
+			if (db_file.has_stored_masks())
+				verbose_stream << "Using reference masking stored in the database." << endl;
+			else if (db_file.header2.masking_id != 0)
+				verbose_stream << "Reference masking stored in the database was computed with different parameters and will not be used." << endl;
+		}
+	}
 	if (config.algo == Config::double_indexed && config.small_query) {
 		timer.go("Building query seed hash set");
 		query_seeds_hashed = new Hashed_seed_set(query_seqs::get());
 	}
 	timer.finish();
 
-	char *query_buffer = nullptr;
 	const pair<size_t, size_t> query_len_bounds = query_seqs::data_->len_bounds(shapes[0].length_);
 
-	if (!config.swipe_all) {
-		timer.go("Building query histograms");
-		query_hst = Partitioned_histogram(*query_seqs::data_, false, &no_filter);
-
-		timer.go("Allocating buffers");
-		query_buffer = SeedArray::alloc_buffer(query_hst);
-		timer.finish();
-	}
-
 	log_rss();
 
 	PtrVector<TempFile> tmp_file;
@@ -240,6 +427,12 @@ void run_query_chunk(DatabaseFile &db_file,
 
 	log_rss();
 
+	// Stored masks are applied only to the reference blocks, other loads like the dictionary in join_blocks
+	// require the unmasked sequences.
+	db_file.apply_stored_masks = config.masking == 1 && !config.no_ref_masking && db_file.has_stored_masks();
+	// Reference blocks that are not masked at all are used in place of the memory mapping.
+	db_file.map_seqs = config.masking != 1 || config.no_ref_masking;
+
 	if (config.multiprocessing) {
 		auto work = P->get_stack(stack_align_todo);
 		P->create_stack_from_file(stack_align_wip, get_ref_part_file_name(stack_align_wip, query_chunk));
@@ -256,7 +449,7 @@ void run_query_chunk(DatabaseFile &db_file,
 			P->log("SEARCH BEGIN "+std::to_string(query_chunk)+" "+std::to_string(chunk.i));
 
 			db_file.load_seqs(&block_to_database_id, (size_t)(0), &ref_seqs::data_, &ref_ids::data_, true, options.db_filter ? options.db_filter : metadata.taxon_filter, true, chunk);
-			run_ref_chunk(db_file, query_chunk, query_len_bounds, query_buffer, master_out, tmp_file, params, metadata);
+			run_ref_chunk(db_file, query_chunk, query_len_bounds, master_out, tmp_file, params, metadata);
 
 			ReferenceDictionary::get().save_block(query_chunk, chunk.i);
 			ReferenceDictionary::get().clear_block(chunk.i);
@@ -272,16 +465,65 @@ void run_query_chunk(DatabaseFile &db_file,
 			log_rss();
 		}
 	} else {
-		for (current_ref_block = 0;
-			 db_file.load_seqs(&block_to_database_id, (size_t)(config.chunk_size*1e9), &ref_seqs::data_, &ref_ids::data_, true, options.db_filter ? options.db_filter : metadata.taxon_filter);
-			 ++current_ref_block) {
-			run_ref_chunk(db_file, query_chunk, query_len_bounds, query_buffer, master_out, tmp_file, params, metadata);
+		if (!ref_block_cache.empty()) {
+			for (current_ref_block = 0; current_ref_block < ref_block_cache.size(); ++current_ref_block) {
+				set_ref_block(ref_block_cache[current_ref_block]);
+				run_ref_chunk(db_file, query_chunk, query_len_bounds, master_out, tmp_file, params, metadata, &ref_block_cache[current_ref_block]);
+			}
+		}
+		else {
+			const BitVector *filter = options.db_filter ? options.db_filter : metadata.taxon_filter;
+			const bool prefetch = use_prefetch();
+			// Besides the cached blocks, the memory has to hold the search of the current block (estimated at 20 bytes
+			// per letter divided by the index chunks) and, with prefetching, the next block.
+			const size_t cache_budget = query_chunk == 0 ? block_cache_budget(last_query_chunk) : 0,
+				search_mem = (size_t)(config.chunk_size * 1e9 * 20.0 / config.lowmem);
+			bool cache = cache_budget > 0;
+			size_t cache_size = 0;
+			std::future<RefBlock*> next;
+			// The next block is loaded in the background while the current one is aligned. The database file is
+			// not accessed by the alignment stage.
+			auto start_prefetch = [&]() {
+				const size_t next_block = current_ref_block + 1;
+				next = std::async(std::launch::async, load_ref_block, std::ref(db_file), filter, next_block, true);
+			};
+			unique_ptr<RefBlock> block(load_ref_block(db_file, filter, 0, false));
+			for (current_ref_block = 0; block; ++current_ref_block) {
+				set_ref_block(*block);
+				run_ref_chunk(db_file, query_chunk, query_len_bounds, master_out, tmp_file, params, metadata, block.get(),
+					prefetch ? std::function<void()>(start_prefetch) : std::function<void()>());
+				if (cache) {
+					const size_t n = block->mem_size();
+					if (cache_size + n * (prefetch ? 2 : 1) + search_mem <= cache_budget) {
+						cache_size += n;
+						ref_block_cache.push_back(block.release());
+					}
+					else {
+						log_stream << "Reference blocks exceed the available memory and will not be kept across query chunks." << endl;
+						ref_block_cache.clear();
+						cache = false;
+					}
+				}
+				if (block) {
+					timer.go("Deallocating reference");
+					block.reset();
+					timer.finish();
+				}
+				if (prefetch) {
+					timer.go("Waiting for the next reference block");
+					block.reset(next.get());
+					timer.finish();
+				}
+				else
+					block.reset(load_ref_block(db_file, filter, current_ref_block + 1, false));
+			}
 		}
 		log_rss();
 	}
+	db_file.apply_stored_masks = false;
+	db_file.map_seqs = false;
 
 	timer.go("Deallocating buffers");
-	delete[] query_buffer;
 	delete query_seeds;
 	delete Extension::memory;
 	query_seeds = 0;
@@ -486,7 +728,9 @@ void master_thread(DatabaseFile *db_file, task_timer &total_timer, Metadata &met
 		if (config.multiprocessing)
 			P->create_stack_from_file(stack_align_todo, get_ref_part_file_name(stack_align_todo, current_query_chunk));
 
-		run_query_chunk(*db_file, current_query_chunk, *master_out, unaligned_file.get(), aligned_file.get(), metadata, options);
+		// The reference block cache is only useful if another query chunk follows.
+		const bool last_query_chunk = options.self ? query_file_offset >= db_file->ref_header.sequences : query_file->eof();
+		run_query_chunk(*db_file, current_query_chunk, last_query_chunk, *master_out, unaligned_file.get(), aligned_file.get(), metadata, options);
 
 		if (config.multiprocessing)
 			P->delete_stack(stack_align_todo);
@@ -510,6 +754,12 @@ void master_thread(DatabaseFile *db_file, task_timer &total_timer, Metadata &met
 	if (aligned_file.get())
 		aligned_file->close();
 
+	delete SeedIndex::instance;
+	SeedIndex::instance = nullptr;
+	delete SeedFrequency::instance;
+	SeedFrequency::instance = nullptr;
+	ref_block_cache.clear();
+
 	if (!options.db) {
 		timer.go("Closing the database file");
 		db_file->close();
@@ -585,7 +835,7 @@ void run(const Options &options)
 		metadata.taxon_nodes = new TaxonomyNodes(db_file->seek(db_file->header2.taxon_nodes_offset), db_file->ref_header.build);
 		if (taxon_filter) {
 			timer.go("Building taxonomy filter");
-			metadata.taxon_filter = new TaxonomyFilter(config.taxonlist, config.taxon_exclude, *metadata.taxon_list, *metadata.taxon_nodes);
+			metadata.taxon_filter = new TaxonomyFilter(config.taxonlist, config.taxon_exclude, *metadata.taxon_list, *metadata.taxon_nodes, db_file->taxon_ranges());
 		}
 		timer.finish();
 	}
@@ -23,10 +23,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace DISPATCH_ARCH {
 
+template<typename _fp>
 bool verify_hit(const Letter *query, const Letter *subject, unsigned sid)
 {
-	const Finger_print fq(query), fs(subject);
-	if (fq.match(fs) < config.min_identities)
+	if (finger_print_match<_fp>(query, subject) < config.min_identities)
 		return false;
 	return true;
 	/*unsigned delta, len;
@@ -41,7 +41,7 @@ inline bool match_shape_mask(const uint64_t mask, const uint64_t shape_mask)
 inline bool is_lower_chunk(const Letter *subject, unsigned sid)
 {
 	Packed_seed seed;
-	if (config.algo == Config::double_indexed)
+	if (config.algo != Config::query_indexed)
 		shapes[sid].set_seed(seed, subject);
 	else
 		shapes[sid].set_seed_shifted(seed, subject);
@@ -51,7 +51,7 @@ inline bool is_lower_chunk(const Letter *subject, unsigned sid)
 inline bool is_lower_or_equal_chunk(const Letter *subject, unsigned sid)
 {
 	Packed_seed seed;
-	if (config.algo == Config::double_indexed)
+	if (config.algo != Config::query_indexed)
 		shapes[sid].set_seed(seed, subject);
 	else
 		shapes[sid].set_seed_shifted(seed, subject);
@@ -86,7 +86,8 @@ inline bool previous_shape_collision(uint64_t mask, uint64_t shape_mask, const L
 	return !is_high_frequency(subject, sid, true);
 }
 
-bool is_primary_hit(const Letter *query,
+template<typename _fp>
+static bool is_primary_hit(const Letter *query,
 	const Letter *subject,
 	const unsigned seed_offset,
 	const unsigned sid,
@@ -102,11 +103,11 @@ bool is_primary_hit(const Letter *query,
 			mask |= reduced_match32(query + 32, subject + 32, len - i - 32) << 32;
 		for (unsigned j = 0; j < 32 && i < shape_len; ++j) {
 			for (unsigned k = 0; k < sid; ++k)
-				if (previous_shape_collision(mask, shapes[k].mask_, &subject[j], k) && verify_hit(&query[j], &subject[j], k))
+				if (previous_shape_collision(mask, shapes[k].mask_, &subject[j], k) && verify_hit<_fp>(&query[j], &subject[j], k))
 					return false;
-			if (i < seed_offset && shape_collision_left(mask, current_mask, &subject[j], sid, chunked) && verify_hit(&query[j], &subject[j], sid))
+			if (i < seed_offset && shape_collision_left(mask, current_mask, &subject[j], sid, chunked) && verify_hit<_fp>(&query[j], &subject[j], sid))
 				return false;
-			if (chunked && i > seed_offset && shape_collision_right(mask, current_mask, &subject[j], sid) && verify_hit(&query[j], &subject[j], sid))
+			if (chunked && i > seed_offset && shape_collision_right(mask, current_mask, &subject[j], sid) && verify_hit<_fp>(&query[j], &subject[j], sid))
 				return false;
 			++i;
 			mask >>= 1;
@@ -117,4 +118,20 @@ bool is_primary_hit(const Letter *query,
 	return true;
 }
 
+bool is_primary_hit(const Letter *query,
+	const Letter *subject,
+	const unsigned seed_offset,
+	const unsigned sid,
+	const unsigned len)
+{
+	switch (config.fingerprint_width) {
+	case 32:
+		return is_primary_hit<Byte_finger_print_32>(query, subject, seed_offset, sid, len);
+	case 64:
+		return is_primary_hit<Byte_finger_print_64>(query, subject, seed_offset, sid, len);
+	default:
+		return is_primary_hit<Byte_finger_print_48>(query, subject, seed_offset, sid, len);
+	}
+}
+
 }
\ No newline at end of file
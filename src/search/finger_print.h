@@ -42,9 +42,35 @@ struct Byte_finger_print_32
 	{
 		return popcount64(match_block(r1, rhs.r1));
 	}
-	__m256i r1;
+	bool operator==(const Byte_finger_print_32& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	alignas(32) __m256i r1;
+};
+
+#ifdef __AVX512BW__
+
+struct Byte_finger_print_64
+{
+	Byte_finger_print_64(const Letter* q) :
+#ifdef SEQ_MASK
+		r(letter_mask(_mm512_loadu_si512((const void*)(q - 32))))
+#else
+		r(_mm512_loadu_si512((const void*)(q - 32)))
+#endif
+	{}
+	unsigned match(const Byte_finger_print_64& rhs) const
+	{
+		return popcount64(_mm512_cmpeq_epi8_mask(r, rhs.r));
+	}
+	bool operator==(const Byte_finger_print_64& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	alignas(64) __m512i r;
 };
 
+#else
+
 struct Byte_finger_print_64
 {
 	Byte_finger_print_64(const Letter* q) :
@@ -64,12 +90,129 @@ struct Byte_finger_print_64
 	{
 		return popcount64(match_block(r1, rhs.r1) << 32 | match_block(r2, rhs.r2));
 	}
-	__m256i r1, r2;
+	bool operator==(const Byte_finger_print_64& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	alignas(32) __m256i r1, r2;
 };
 
 #endif
 
-#ifdef __SSE2__
+#elif defined(__SSE2__)
+
+struct Byte_finger_print_32
+{
+	Byte_finger_print_32(const Letter* q) :
+#ifdef SEQ_MASK
+		r1(letter_mask(_mm_loadu_si128((__m128i const*)(q - 16)))),
+		r2(letter_mask(_mm_loadu_si128((__m128i const*)q)))
+#else
+		r1(_mm_loadu_si128((__m128i const*)(q - 16))),
+		r2(_mm_loadu_si128((__m128i const*)q))
+#endif
+	{}
+	static uint64_t match_block(__m128i x, __m128i y)
+	{
+		return (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+	}
+	unsigned match(const Byte_finger_print_32& rhs) const
+	{
+		return popcount64(match_block(r1, rhs.r1) << 16 | match_block(r2, rhs.r2));
+	}
+	bool operator==(const Byte_finger_print_32& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	alignas(16) __m128i r1, r2;
+};
+
+struct Byte_finger_print_64
+{
+	Byte_finger_print_64(const Letter* q) :
+#ifdef SEQ_MASK
+		r1(letter_mask(_mm_loadu_si128((__m128i const*)(q - 32)))),
+		r2(letter_mask(_mm_loadu_si128((__m128i const*)(q - 16)))),
+		r3(letter_mask(_mm_loadu_si128((__m128i const*)q))),
+		r4(letter_mask(_mm_loadu_si128((__m128i const*)(q + 16))))
+#else
+		r1(_mm_loadu_si128((__m128i const*)(q - 32))),
+		r2(_mm_loadu_si128((__m128i const*)(q - 16))),
+		r3(_mm_loadu_si128((__m128i const*)q)),
+		r4(_mm_loadu_si128((__m128i const*)(q + 16)))
+#endif
+	{}
+	static uint64_t match_block(__m128i x, __m128i y)
+	{
+		return (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+	}
+	unsigned match(const Byte_finger_print_64& rhs) const
+	{
+		return popcount64(match_block(r1, rhs.r1) << 48 | match_block(r2, rhs.r2) << 32 | match_block(r3, rhs.r3) << 16 | match_block(r4, rhs.r4));
+	}
+	bool operator==(const Byte_finger_print_64& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	alignas(16) __m128i r1, r2, r3, r4;
+};
+
+#else
+
+// Scalar fingerprint of the window [q - LEFT, q - LEFT + WIDTH).
+template<int WIDTH, int LEFT>
+struct Byte_finger_print_scalar
+{
+	Byte_finger_print_scalar()
+	{}
+	Byte_finger_print_scalar(const Letter *q)
+	{
+		memcpy(r, q - LEFT, WIDTH);
+#ifdef SEQ_MASK
+		for (int i = 0; i < WIDTH; ++i)
+			r[i] &= LETTER_MASK;
+#endif
+	}
+	unsigned match(const Byte_finger_print_scalar &rhs) const
+	{
+		unsigned n = 0;
+		for (int i = 0; i < WIDTH; ++i)
+			if (r[i] == rhs.r[i])
+				++n;
+		return n;
+	}
+	bool operator==(const Byte_finger_print_scalar& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	Letter r[WIDTH];
+};
+
+typedef Byte_finger_print_scalar<32, 16> Byte_finger_print_32;
+typedef Byte_finger_print_scalar<64, 32> Byte_finger_print_64;
+
+#endif
+
+#ifdef __AVX512BW__
+
+// The 48 letter window is held in one 64 byte register, so a comparison takes a single instruction.
+struct Byte_finger_print_48
+{
+	Byte_finger_print_48(const Letter *q) :
+#ifdef SEQ_MASK
+		r(letter_mask(_mm512_maskz_loadu_epi8(WINDOW_MASK, q - 16)))
+#else
+		r(_mm512_maskz_loadu_epi8(WINDOW_MASK, q - 16))
+#endif
+	{}
+	unsigned match(const Byte_finger_print_48 &rhs) const
+	{
+		return popcount64(_mm512_mask_cmpeq_epi8_mask(WINDOW_MASK, r, rhs.r));
+	}
+	bool operator==(const Byte_finger_print_48& rhs) const {
+		return match(rhs) >= config.min_identities;
+	}
+	static const __mmask64 WINDOW_MASK = 0xffffffffffffllu;
+	alignas(64) __m512i r;
+};
+
+#elif defined(__SSE2__)
 
 struct Byte_finger_print_48
 {
@@ -130,8 +273,11 @@ struct Byte_finger_print_48
 
 #endif
 
-#ifdef __AVX2__
-typedef Byte_finger_print_48 Finger_print;
-#else
 typedef Byte_finger_print_48 Finger_print;
-#endif
\ No newline at end of file
+
+// Number of identities in the fingerprint windows of type _fp (see --fingerprint-width).
+template<typename _fp>
+static inline unsigned finger_print_match(const Letter* q, const Letter* s)
+{
+	return _fp(q).match(_fp(s));
+}
@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace Search {
 
+template<typename _fp>
 static inline bool verify_hit(const Letter* q, const Letter* s, int score_cutoff, bool left, uint32_t match_mask, unsigned sid) {
 	if (config.lowmem > 1) {
 		if ((shapes[sid].mask_ & match_mask) == shapes[sid].mask_) {
@@ -41,16 +42,15 @@ static inline bool verify_hit(const Letter* q, const Letter* s, int score_cutoff
 				return false;
 		}
 	}
-	Finger_print fq(q), fs(s);
-	const unsigned id = fq.match(fs);
-	return id >= config.min_identities;
+	return finger_print_match<_fp>(q, s) >= config.min_identities;
 }
 
+template<typename _fp>
 static inline bool verify_hits(uint32_t mask, const Letter* q, const Letter* s, int score_cutoff, bool left, uint32_t match_mask, unsigned sid) {
 	int shift = 0;
 	while (mask != 0) {
 		int i = ctz(mask);
-		if (verify_hit(q + i + shift, s + i + shift, score_cutoff, left, match_mask >> (i + shift), sid))
+		if (verify_hit<_fp>(q + i + shift, s + i + shift, score_cutoff, left, match_mask >> (i + shift), sid))
 			return true;
 		mask >>= i + 1;
 		shift += i + 1;
@@ -58,6 +58,7 @@ static inline bool verify_hits(uint32_t mask, const Letter* q, const Letter* s,
 	return false;
 }
 
+template<typename _fp>
 static inline bool left_most_filter(const sequence &query,
 	const Letter* subject,
 	const int seed_offset,
@@ -94,7 +95,7 @@ static inline bool left_most_filter(const sequence &query,
 	const uint32_t left_hit = context.current_matcher.hit(match_mask_left, len_left) & query_mask_left;
 
 	if (first_shape && !chunked)
-		return left_hit == 0 || !verify_hits(left_hit, q, s, score_cutoff, true, match_mask_left, shape_id);
+		return left_hit == 0 || !verify_hits<_fp>(left_hit, q, s, score_cutoff, true, match_mask_left, shape_id);
 
 	const uint32_t len_right = window - window_left - 1,
 		match_mask_right = match_mask >> (window_left + 1),
@@ -103,8 +104,8 @@ static inline bool left_most_filter(const sequence &query,
 	const PatternMatcher& right_matcher = chunked ? context.current_matcher : context.previous_matcher;
 	const uint32_t right_hit = right_matcher.hit(match_mask_right, len_right) & query_mask_right;
 
-	return (left_hit == 0 || !verify_hits(left_hit, q, s, score_cutoff, true, match_mask_left, shape_id))
-		&& (right_hit == 0 || !verify_hits(right_hit, q + window_left + 1, s + window_left + 1, score_cutoff, false, match_mask_right, shape_id));
+	return (left_hit == 0 || !verify_hits<_fp>(left_hit, q, s, score_cutoff, true, match_mask_left, shape_id))
+		&& (right_hit == 0 || !verify_hits<_fp>(right_hit, q + window_left + 1, s + window_left + 1, score_cutoff, false, match_mask_right, shape_id));
 }
 
 }
\ No newline at end of file
@@ -37,6 +37,7 @@ struct Context {
 	const PatternMatcher previous_matcher, current_matcher;
 	const Util::Scores::CutoffTable cutoff_table;
 	const int short_query_ungapped_cutoff;
+	const bool symmetric_matrix;
 };
 
 }
@@ -61,10 +62,16 @@ struct Stage1_hit
 	unsigned q, s;
 };
 
-void search_shape(unsigned sid, unsigned query_block, char *query_buffer, char *ref_buffer, const Parameters &params);
+struct SeedIndex;
+struct SubjectIndex;
+
+void search_shape(unsigned sid, unsigned query_block, char *ref_buffer, const Parameters &params, SeedIndex *ref_index);
+void search_shape(unsigned sid, unsigned query_block, const Parameters &params, const SubjectIndex &index);
 bool use_single_indexed(double coverage, size_t query_letters, size_t ref_letters);
+bool use_subject_indexed(size_t query_letters, size_t ref_letters);
 void setup_search();
 void setup_search_cont();
+void setup_finger_print(const Sequence_set& queries);
 
 namespace Search {
 
@@ -21,12 +21,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
 #include "../data/reference.h"
+#include "../data/subject_index.h"
 #include "../basic/config.h"
 #include "seed_complexity.h"
 #include "search.h"
 
 double SeedComplexity::prob_[AMINO_ACID_COUNT];
 const double SINGLE_INDEXED_SEED_SPACE_MAX_COVERAGE = 0.15;
+// The subject index holds the seeds of all shapes and is kept for all query chunks, so its size is limited.
+const size_t SUBJECT_INDEXED_MAX_INDEX_SIZE = 2000000000;
+static bool default_min_identities;
 
 void setup_search_cont()
 {
@@ -54,8 +58,17 @@ bool use_single_indexed(double coverage, size_t query_letters, size_t ref_letter
 		return query_letters < 3000000llu && query_letters * 2000llu < ref_letters;
 }
 
+// Many query letters against a small reference: the reference is indexed once and the query seeds are looked up
+// in the index, instead of building and joining query seed arrays for every query chunk. The size of the index grows
+// with the number of shapes, so the sensitive modes allow smaller references.
+bool use_subject_indexed(size_t query_letters, size_t ref_letters)
+{
+	return SubjectIndex::mem_estimate(ref_letters) <= SUBJECT_INDEXED_MAX_INDEX_SIZE && query_letters >= ref_letters * 20llu;
+}
+
 void setup_search()
 {
+	default_min_identities = config.min_identities == 0;
 	if (config.sensitivity == Sensitivity::ULTRA_SENSITIVE) {
 		Config::set_option(config.freq_sd, 20.0);
 		Config::set_option(config.min_identities, 9u);
@@ -105,6 +118,9 @@ void setup_search()
 	if(config.algo==Config::query_indexed)
 		config.lowmem = 1;
 	else {
+		// The subject index is not chunked.
+		if (config.algo == Config::subject_indexed)
+			config.lowmem = 1;
 		switch (config.sensitivity) {
 		case Sensitivity::ULTRA_SENSITIVE:
 			Config::set_option(config.index_mode, 13u);
@@ -132,9 +148,34 @@ void setup_search()
 	SeedComplexity::init(Reduction::reduction);
 	config.gapped_filter_diag_score = score_matrix.rawscore(config.gapped_filter_diag_bit_score);
 
-	message_stream << "Algorithm: " << (config.algo == Config::double_indexed ? "Double-indexed" : "Query-indexed") << endl;
+	message_stream << "Algorithm: " << (config.algo == Config::double_indexed ? "Double-indexed" : (config.algo == Config::query_indexed ? "Query-indexed" : "Subject-indexed")) << endl;
 	verbose_stream << "Reduction: " << Reduction::reduction << endl;
 
 	verbose_stream << "Seed frequency SD: " << config.freq_sd << endl;
 	verbose_stream << "Shape configuration: " << ::shapes << endl;
+}
+
+// Called for the first query block only, all blocks are searched with the same width. With --fingerprint-width auto,
+// the width is chosen from the lengths of the sequences of that block.
+void setup_finger_print(const Sequence_set& queries)
+{
+	if (config.fingerprint_width_str == "auto") {
+		// The 48 letter window extends past the end of short queries, a narrower window keeps the identity count
+		// informative. For long queries in the fast modes, the wider window filters more stage 1 hits.
+		const double avg_len = queries.avg_len();
+		if (avg_len < 100)
+			config.fingerprint_width = 32;
+		else if (avg_len >= 1000 && config.sensitivity <= Sensitivity::MID_SENSITIVE)
+			config.fingerprint_width = 64;
+		else
+			config.fingerprint_width = 48;
+	}
+	else if (config.fingerprint_width_str == "32" || config.fingerprint_width_str == "48" || config.fingerprint_width_str == "64")
+		config.fingerprint_width = (unsigned)std::stoi(config.fingerprint_width_str);
+	else
+		throw std::runtime_error("Fingerprint width needs to be 32, 48, 64 or auto.");
+
+	if (default_min_identities)
+		config.min_identities = (config.min_identities * config.fingerprint_width + 24) / 48;
+	verbose_stream << "Fingerprint width: " << config.fingerprint_width << ", minimum identities: " << config.min_identities << endl;
 }
\ No newline at end of file
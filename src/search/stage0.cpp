@@ -20,8 +20,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
 #include <thread>
+#include <algorithm>
+#include <cmath>
 #include <utility>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "search.h"
 #include "../util/algo/hash_join.h"
 #include "../util/algo/radix_sort.h"
@@ -29,6 +33,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../data/seed_array.h"
 #include "../data/queries.h"
 #include "../data/frequent_seeds.h"
+#include "../data/seed_index.h"
+#include "../data/subject_index.h"
 #include "trace_pt_buffer.h"
 #include "../util/data_structures/double_array.h"
 #include "../util/system/system.h"
@@ -44,38 +50,123 @@ void seed_join_worker(
 	atomic<unsigned> *seedp,
 	const SeedPartitionRange *seedp_range,
 	DoubleArray<SeedArray::_pos> *query_seed_hits,
-	DoubleArray<SeedArray::_pos> *ref_seeds_hits)
+	DoubleArray<SeedArray::_pos> *ref_seeds_hits,
+	vector<Sd> *query_sds,
+	vector<Sd> *ref_sds)
 {
 	unsigned p;
 	const unsigned bits = (unsigned)ceil(shapes[0].weight_ * Reduction::reduction.bit_size_exact()) - Const::seedp_bits;
+	JoinScratch scratch;
 	while ((p = (*seedp)++) < seedp_range->end()) {
 		std::pair<DoubleArray<SeedArray::_pos>, DoubleArray<SeedArray::_pos>> join = hash_join(
 			Relation<SeedArray::Entry>(query_seeds->begin(p), query_seeds->size(p)),
 			Relation<SeedArray::Entry>(ref_seeds->begin(p), ref_seeds->size(p)),
+			scratch,
 			bits);
 		query_seed_hits[p] = join.first;
 		ref_seeds_hits[p] = join.second;
+		// The frequency statistics are taken while the join result of the partition is still in cache.
+		Frequent_seeds::partition_sd(query_seed_hits[p], ref_seeds_hits[p], (*query_sds)[p - seedp_range->begin()], (*ref_sds)[p - seedp_range->begin()]);
 	}
 }
 
-void search_worker(atomic<unsigned> *seedp, const SeedPartitionRange *seedp_range, unsigned shape, size_t thread_id, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, const Search::Context *context)
+// Seed groups of frequent seeds can dominate their partition. Groups above this number of seed pairs are split
+// along the query side, or along the subject side if the subjects alone exceed it, and shared among the threads
+// once they have run out of partitions.
+const size_t MAX_SEED_GROUP_SIZE = 1 << 20;
+
+struct SeedGroupQueue {
+
+	struct Group {
+		const Packed_loc *q, *s;
+		size_t nq, ns;
+	};
+
+	SeedGroupQueue(unsigned active):
+		active_(active)
+	{}
+
+	void push(const Packed_loc *q, size_t nq, const Packed_loc *s, size_t ns) {
+		const size_t n = std::max(MAX_SEED_GROUP_SIZE / ns, (size_t)1), m = std::min(ns, MAX_SEED_GROUP_SIZE);
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			for (size_t i = 0; i < nq; i += n)
+				for (size_t j = 0; j < ns; j += m)
+					groups_.push_back({ q + i, s + j, std::min(n, nq - i), std::min(m, ns - j) });
+		}
+		cv_.notify_all();
+	}
+
+	// Called by a thread that has left the partition loop and will not push any more groups.
+	void finish() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (--active_ == 0)
+			cv_.notify_all();
+	}
+
+	// Waits for a group. Returns false once the queue is empty and all threads have finished pushing.
+	bool pop(Group &g) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		cv_.wait(lock, [this] { return !groups_.empty() || active_ == 0; });
+		if (groups_.empty())
+			return false;
+		g = groups_.back();
+		groups_.pop_back();
+		return true;
+	}
+
+private:
+
+	unsigned active_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	vector<Group> groups_;
+
+};
+
+void search_worker(atomic<unsigned> *seedp, const SeedPartitionRange *seedp_range, unsigned shape, size_t thread_id, DoubleArray<SeedArray::_pos> *query_seed_hits, DoubleArray<SeedArray::_pos> *ref_seed_hits, const Search::Context *context, SeedGroupQueue *queue)
 {
 	Trace_pt_buffer::Iterator* out = new Trace_pt_buffer::Iterator(*Trace_pt_buffer::instance, thread_id);
 	Statistics stats;
 	unsigned p;
 	while ((p = (*seedp)++) < seedp_range->end())
-		for (auto it = JoinIterator<SeedArray::_pos>(query_seed_hits[p].begin(), ref_seed_hits[p].begin()); it; ++it)
-			Search::stage1(it.r->begin(), it.r->size(), it.s->begin(), it.s->size(), stats, *out, shape, *context);
+		for (auto it = JoinIterator<SeedArray::_pos>(query_seed_hits[p].begin(), ref_seed_hits[p].begin()); it; ++it) {
+			const size_t nq = it.r->size(), ns = it.s->size();
+			if (nq * ns > MAX_SEED_GROUP_SIZE)
+				queue->push(it.r->begin(), nq, it.s->begin(), ns);
+			else
+				Search::stage1(it.r->begin(), nq, it.s->begin(), ns, stats, *out, shape, *context);
+		}
+	queue->finish();
+
+	SeedGroupQueue::Group g;
+	while (queue->pop(g))
+		Search::stage1(g.q, g.nq, g.s, g.ns, stats, *out, shape, *context);
 	delete out;
 	statistics += stats;
 }
 
-void search_shape(unsigned sid, unsigned query_block, char *query_buffer, char *ref_buffer, const Parameters &params)
+static void build_query_seed_array(unsigned sid, SeedPartitionRange range, unsigned threads, SeedArray **out)
+{
+	*out = new SeedArray(*query_seqs::data_, sid, range, query_seqs::data_->partition(threads), &no_filter);
+}
+
+void search_shape(unsigned sid, unsigned query_block, char *ref_buffer, const Parameters &params, SeedIndex *ref_index)
 {
 	::partition<unsigned> p(Const::seedp, config.lowmem);
 	DoubleArray<SeedArray::_pos> query_seed_hits[Const::seedp], ref_seed_hits[Const::seedp];
 	log_rss();
 
+	// The query seed array does not use the reference buffer, so it is built concurrently with the reference seed
+	// array. The threads are split between both in proportion to their letters, so that they finish at about the same
+	// time. A reference seed array loaded from the seed index needs no enumeration threads.
+	unsigned query_threads = config.threads_, ref_threads = 0;
+	if (!ref_index) {
+		const double q = (double)query_seqs::data_->letters(), r = (double)ref_seqs::data_->letters();
+		query_threads = config.threads_ > 1 ? std::min(std::max((unsigned)std::lround(config.threads_ * q / (q + r)), 1u), config.threads_ - 1) : 0;
+		ref_threads = config.threads_ - query_threads;
+	}
+
 	for (unsigned chunk = 0; chunk < p.parts; ++chunk) {
 		message_stream << "Processing query block " << query_block + 1
 			<< ", reference block " << (current_ref_block + 1) << "/" << params.ref_blocks
@@ -86,42 +177,57 @@ void search_shape(unsigned sid, unsigned query_block, char *query_buffer, char *
 		const SeedPartitionRange range(p.getMin(chunk), p.getMax(chunk));
 		current_range = range;
 
-		task_timer timer("Building reference seed array", true);
+		SeedArray *query_idx = nullptr;
+		std::thread query_thread;
+		if (query_threads > 0)
+			query_thread = std::thread(build_query_seed_array, sid, range, query_threads, &query_idx);
+
+		task_timer timer(ref_index ? "Loading reference seed array" : "Building reference seed array", true);
 		SeedArray *ref_idx;
-		if (config.algo == Config::query_indexed)
-			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, query_seeds);
+		if (ref_index) {
+			ref_idx = new SeedArray(ref_hst.get(sid), range, ref_buffer);
+			ref_index->load(current_ref_block, sid, range, ref_idx->begin(range.begin()));
+		}
+		else if (config.algo == Config::query_indexed)
+			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, query_seeds, 1, ref_threads);
 		else if (query_seeds_hashed != 0)
-			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, query_seeds_hashed);
+			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, query_seeds_hashed, 1, ref_threads);
 		else
-			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, &no_filter);
+			ref_idx = new SeedArray(*ref_seqs::data_, sid, ref_hst.get(sid), range, ref_hst.partition(), ref_buffer, &no_filter, config.minimizer_window, ref_threads);
 
 		timer.go("Building query seed array");
-		SeedArray *query_idx = new SeedArray(*query_seqs::data_, sid, query_hst.get(sid), range, query_hst.partition(), query_buffer, &no_filter);
+		if (query_thread.joinable())
+			query_thread.join();
+		else
+			build_query_seed_array(sid, range, config.threads_, &query_idx);
 
 		timer.go("Computing hash join");
 		atomic<unsigned> seedp(range.begin());
+		vector<Sd> query_sds(range.size()), ref_sds(range.size());
 		vector<std::thread> threads;
 		for (size_t i = 0; i < config.threads_; ++i)
-			threads.emplace_back(seed_join_worker, query_idx, ref_idx, &seedp, &range, query_seed_hits, ref_seed_hits);
+			threads.emplace_back(seed_join_worker, query_idx, ref_idx, &seedp, &range, query_seed_hits, ref_seed_hits, &query_sds, &ref_sds);
 		for (auto &t : threads)
 			t.join();
 
 		timer.go("Building seed filter");
-		frequent_seeds.build(sid, range, query_seed_hits, ref_seed_hits);
+		frequent_seeds.build(sid, range, query_seed_hits, ref_seed_hits, query_sds, ref_sds);
 
 		Search::Context* context = nullptr;
 		const vector<uint32_t> patterns = shapes.patterns(0, sid + 1);
 		context = new Search::Context{ {patterns.data(), patterns.data() + patterns.size() - 1 },
 			{patterns.data(), patterns.data() + patterns.size() },
 			config.ungapped_evalue,
-			score_matrix.rawscore(config.short_query_ungapped_bitscore)
+			score_matrix.rawscore(config.short_query_ungapped_bitscore),
+			score_matrix.symmetric()
 		};
 
 		timer.go("Searching alignments");
 		seedp = range.begin();
 		threads.clear();
+		SeedGroupQueue queue(config.threads_);
 		for (size_t i = 0; i < config.threads_; ++i)
-			threads.emplace_back(search_worker, &seedp, &range, sid, i, query_seed_hits, ref_seed_hits, context);
+			threads.emplace_back(search_worker, &seedp, &range, sid, i, query_seed_hits, ref_seed_hits, context, &queue);
 		for (auto &t : threads)
 			t.join();
 
@@ -129,4 +235,102 @@ void search_shape(unsigned sid, unsigned query_block, char *query_buffer, char *
 		delete query_idx;
 		delete context;
 	}
-}
\ No newline at end of file
+}
+
+const size_t SUBJECT_INDEXED_RANGE_LETTERS = 1 << 22;
+
+// Looks up the query seeds of a range of query sequences in the subject index. In the first pass, the query positions
+// of seeds that are frequent in the reference (see SubjectIndex::cap) are masked, in the second pass the remaining
+// seeds are searched. The seed keys are computed from the unmasked letters, so that both passes see the same seeds.
+// The query seeds of a range are sorted by key, so that every seed is looked up once and stage 1 processes all its
+// query positions against the reference group together.
+static void subject_indexed_worker(atomic<size_t> *next, const vector<size_t> *p, unsigned sid, size_t thread_id, const SubjectIndex *index, const Search::Context *context, atomic<size_t> *masked)
+{
+	const Shape &sh = shapes[sid];
+	const uint32_t cap = index->cap(sid);
+	Sequence_set &seqs = query_seqs::get_nc();
+	Trace_pt_buffer::Iterator *out = context ? new Trace_pt_buffer::Iterator(*Trace_pt_buffer::instance, thread_id) : nullptr;
+	Statistics stats;
+	vector<Letter> buf;
+	vector<uint64_t> keys;
+	vector<std::pair<uint64_t, uint64_t>> query_seeds;
+	vector<Packed_loc> q;
+	size_t k, masked_n = 0;
+	while ((k = (*next)++) < p->size() - 1) {
+		query_seeds.clear();
+		for (size_t i = (*p)[k]; i < (*p)[k + 1]; ++i) {
+			const sequence seq = seqs[i];
+			if (seq.length() < sh.length_)
+				continue;
+			buf.resize(seq.length());
+			for (size_t j = 0; j < seq.length(); ++j)
+				buf[j] = (Letter)Reduction::reduction(letter_mask(seq[j]));
+			const size_t n = seq.length() - sh.length_ + 1;
+			keys.resize(n);
+			reduced_seed_keys(buf.data(), n, sh, keys.data());
+			for (size_t j = 0; j < n; ++j)
+				if (keys[j] != INVALID_SEED_KEY)
+					query_seeds.emplace_back(keys[j], seqs.position(i, j));
+		}
+		std::sort(query_seeds.begin(), query_seeds.end());
+
+		for (size_t i = 0; i < query_seeds.size();) {
+			size_t j = i + 1;
+			while (j < query_seeds.size() && query_seeds[j].first == query_seeds[i].first)
+				++j;
+			size_t ns;
+			const Packed_loc *s = index->find(sid, query_seeds[i].first, ns);
+			if (ns > cap && !context) {
+				for (size_t l = i; l < j; ++l)
+					*seqs.data(query_seeds[l].second) |= SEED_MASK;
+				masked_n += j - i;
+			}
+			else if (ns > 0 && ns <= cap && context) {
+				q.clear();
+				for (size_t l = i; l < j; ++l)
+					q.push_back(Packed_loc(query_seeds[l].second));
+				Search::stage1(q.data(), q.size(), s, ns, stats, *out, sid, *context);
+			}
+			i = j;
+		}
+	}
+	delete out;
+	statistics += stats;
+	*masked += masked_n;
+}
+
+void search_shape(unsigned sid, unsigned query_block, const Parameters &params, const SubjectIndex &index)
+{
+	message_stream << "Processing query block " << query_block + 1
+		<< ", reference block " << (current_ref_block + 1) << "/" << params.ref_blocks
+		<< ", shape " << (sid + 1) << "/" << shapes.count() << '.' << endl;
+	current_range = SeedPartitionRange::all();
+	// The sorted query seeds of a range take 16 bytes per letter.
+	const vector<size_t> p = query_seqs::data_->partition(std::max(config.threads_ * 16, unsigned(query_seqs::data_->letters() / SUBJECT_INDEXED_RANGE_LETTERS)));
+
+	task_timer timer("Masking frequent seeds", true);
+	atomic<size_t> next(0), masked(0);
+	vector<std::thread> threads;
+	for (size_t i = 0; i < config.threads_; ++i)
+		threads.emplace_back(subject_indexed_worker, &next, &p, sid, i, &index, nullptr, &masked);
+	for (auto &t : threads)
+		t.join();
+	timer.finish();
+	log_stream << "Masked positions = " << masked << std::endl;
+
+	const vector<uint32_t> patterns = shapes.patterns(0, sid + 1);
+	const Search::Context context{ {patterns.data(), patterns.data() + patterns.size() - 1 },
+		{patterns.data(), patterns.data() + patterns.size() },
+		config.ungapped_evalue,
+		score_matrix.rawscore(config.short_query_ungapped_bitscore),
+		score_matrix.symmetric()
+	};
+
+	timer.go("Searching alignments");
+	next = 0;
+	threads.clear();
+	for (size_t i = 0; i < config.threads_; ++i)
+		threads.emplace_back(subject_indexed_worker, &next, &p, sid, i, &index, &context, &masked);
+	for (auto &t : threads)
+		t.join();
+}
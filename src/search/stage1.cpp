@@ -36,7 +36,7 @@ namespace DISPATCH_ARCH {
 const unsigned tile_size[] = { 1024, 128 };
 
 constexpr ptrdiff_t INNER_LOOP_QUERIES = 6;
-typedef vector<Finger_print, Util::Memory::AlignmentAllocator<Finger_print, 16>> Container;
+typedef vector<Finger_print, Util::Memory::AlignmentAllocator<Finger_print, alignof(Finger_print)>> Container;
 typedef Container::const_iterator Ptr;
 
 struct Range_ref
@@ -60,10 +60,10 @@ void query_register_search(Ptr q,
 {
 	const unsigned q_ref = unsigned(q - ref.q_begin);
 	unsigned s_ref = unsigned(s - ref.s_begin);
-	alignas(16) Finger_print q1 = *(q++), q2 = *(q++), q3 = *(q++), q4 = *(q++), q5 = *(q++), q6 = *q;
+	alignas(alignof(Finger_print)) Finger_print q1 = *(q++), q2 = *(q++), q3 = *(q++), q4 = *(q++), q5 = *(q++), q6 = *q;
 	const Ptr end2 = s_end - (s_end - s) % 4;
 	for (; s < end2; ) {
-		alignas(16) Finger_print s1 = *(s++), s2 = *(s++), s3 = *(s++), s4 = *(s++);
+		alignas(alignof(Finger_print)) Finger_print s1 = *(s++), s2 = *(s++), s3 = *(s++), s4 = *(s++);
 		stats.inc(Statistics::SEED_HITS, 6 * 4);
 		FAST_COMPARE(q1, s1, stats, q_ref, s_ref, 0, 0, hits);
 		FAST_COMPARE(q2, s1, stats, q_ref, s_ref, 1, 0, hits);
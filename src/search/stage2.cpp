@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ****/
 
 #include <limits.h>
+#include <algorithm>
 #include "search.h"
 #include "../util/map.h"
 #include "../data/queries.h"
@@ -40,6 +41,10 @@ using std::vector;
 namespace Search {
 namespace DISPATCH_ARCH {
 
+// Query offsets with fewer hits than this are scored with the scalar kernel.
+static constexpr ptrdiff_t MIN_VECTOR_HITS = 4;
+
+template<typename _fp>
 void search_query_offset(uint64_t q,
 	const Packed_loc* s,
 	const uint32_t *hits,
@@ -47,12 +52,15 @@ void search_query_offset(uint64_t q,
 	Statistics& stats,
 	Trace_pt_buffer::Iterator& out,
 	const unsigned sid,
-	const Context& context)
+	const Context& context,
+	const int* batch_scores)
 {
-	thread_local TextBuffer output_buf;
+	thread_local TextBuffer output_buf, delta_buf;
 
 	constexpr auto N = vector<Stage1_hit>::const_iterator::difference_type(::DISPATCH_ARCH::SIMD::Vector<int8_t>::CHANNELS);
-	const bool long_subject_offsets = ::long_subject_offsets();
+	// The left-most filter assumes that all reference seeds are indexed. With minimizers, the left-most seed hit of a
+	// diagonal may not be in the index, so every hit is kept.
+	const bool long_subject_offsets = ::long_subject_offsets(), compress = config.compress_temp > 0, left_most = config.minimizer_window <= 1;
 	const Letter* query = query_seqs::data_->data(q);
 
 	const Letter* subjects[N];
@@ -68,6 +76,7 @@ void search_query_offset(uint64_t q,
 	const int query_len = query_seqs::data_->length(query_id);
 	const int score_cutoff = query_len > config.short_query_max_len ? context.cutoff_table(query_len) : context.short_query_ungapped_cutoff;
 	size_t hit_count = 0;
+	uint64_t prev_subject = 0;
 
 	const int interval_mod = config.left_most_interval > 0 ? seed_offset % config.left_most_interval : window_left, interval_overhang = std::max(window_left - interval_mod, 0);
 
@@ -76,31 +85,52 @@ void search_query_offset(uint64_t q,
 		const size_t n = std::min(N, hits_end - i);
 		for (size_t j = 0; j < n; ++j)
 			subjects[j] = ref_seqs::data_->data(s[*(i + j)]) - window_left;
-		if(config.ungapped_evalue != 0.0)
+		if (batch_scores)
+			for (size_t j = 0; j < n; ++j)
+				scores[j] = batch_scores[i - hits + j] >= 0 ? batch_scores[i - hits + j] : ungapped_window(query_clipped.data(), subjects[j], window);
+		else if(config.ungapped_evalue != 0.0)
 			DP::window_ungapped_best(query_clipped.data(), subjects, n, window, scores);
 
 		for (size_t j = 0; j < n; ++j) {
 			if (scores[j] > score_cutoff) {
 				stats.inc(Statistics::TENTATIVE_MATCHES2);
-				if (left_most_filter(query_clipped + interval_overhang, subjects[j] + interval_overhang, window_left - interval_overhang, shapes[sid].length_, context, sid == 0, sid, score_cutoff)) {
+				if (!left_most || left_most_filter<_fp>(query_clipped + interval_overhang, subjects[j] + interval_overhang, window_left - interval_overhang, shapes[sid].length_, context, sid == 0, sid, score_cutoff)) {
 					stats.inc(Statistics::TENTATIVE_MATCHES3);
-					if (hit_count == 0) {
-						output_buf.clear();
-						output_buf.write_varint(query_id);
-						output_buf.write_varint(seed_offset);
+					if (compress) {
+						if (hit_count == 0)
+							delta_buf.clear();
+						const uint64_t subject = s[*(i + j)];
+						delta_buf.write_varint64(zigzag_delta(prev_subject, subject));
+						delta_buf.write_varint((unsigned)scores[j]);
+						prev_subject = subject;
+					}
+					else {
+						if (hit_count == 0) {
+							output_buf.clear();
+							output_buf.write_varint(query_id);
+							output_buf.write_varint(seed_offset);
+						}
+						if (long_subject_offsets)
+							output_buf.write_raw((const char*)&s[*(i + j)], 5);
+						else
+							output_buf.write(s[*(i + j)].low);
+						output_buf.write((uint16_t)scores[j]);
 					}
-					if (long_subject_offsets)
-						output_buf.write_raw((const char*)&s[*(i + j)], 5);
-					else
-						output_buf.write(s[*(i + j)].low);
-					output_buf.write((uint16_t)scores[j]);
 					++hit_count;
 				}
 			}
 		}
 	}
 
-	if (hit_count > 0) {
+	if (hit_count > 0 && compress) {
+		output_buf.clear();
+		output_buf.write_varint(query_id);
+		output_buf.write_varint(seed_offset);
+		output_buf.write_varint((unsigned)hit_count);
+		output_buf.write_raw(delta_buf.get_begin(), delta_buf.size());
+		out.push(query_id / align_mode.query_contexts, output_buf.get_begin(), output_buf.size(), hit_count);
+	}
+	else if (hit_count > 0) {
 		if (long_subject_offsets)
 			output_buf.write(packed_uint40_t(0));
 		else
@@ -109,6 +139,88 @@ void search_query_offset(uint64_t q,
 	}
 }
 
+#ifdef __SSE4_1__
+
+// Computes the scores of the (query offset, subject) pairs of a tile that would be scored one at a time with the
+// scalar kernel, i.e. of the query offsets with fewer than MIN_VECTOR_HITS hits. Using a symmetric score matrix, the
+// pairs sharing a subject are scored by the vector kernel the other way round, the subject window against up to N
+// query windows. Only query offsets whose window is not clipped at a sequence boundary are batched, so that all
+// windows have the same geometry. Pairs that are not batched keep a score of -1. Returns false if no pair was batched.
+static bool batch_window_scores(const FlatArray<uint32_t>& hits, const Packed_loc* q, const Packed_loc* s, vector<int>& out)
+{
+	struct Pair {
+		bool operator<(const Pair& x) const {
+			return subject < x.subject || (subject == x.subject && hit < x.hit);
+		}
+		uint32_t subject, hit, query;
+	};
+
+	constexpr int N = ::DISPATCH_ARCH::SIMD::Vector<int8_t>::CHANNELS;
+	thread_local vector<Pair> pairs;
+	thread_local vector<Letter> query_windows;
+	const int w = config.ungapped_window, window = w * 2, stride = (window + 63) & ~63;
+	const uint32_t* hits_begin = hits.begin(0);
+
+	pairs.clear();
+	for (uint32_t i = 0; i < (uint32_t)hits.size(); ++i) {
+		const uint32_t* r1 = hits.begin(i), * r2 = hits.end(i);
+		if (r2 - r1 < MIN_VECTOR_HITS)
+			for (const uint32_t* j = r1; j < r2; ++j)
+				pairs.push_back({ *j, uint32_t(j - hits_begin), i });
+	}
+	if (pairs.size() < (size_t)MIN_VECTOR_HITS)
+		return false;
+	std::sort(pairs.begin(), pairs.end());
+
+	bool batched = false;
+	const Letter* query_ptr[N];
+	int scores[N];
+	for (auto i = pairs.begin(); i < pairs.end();) {
+		auto run_end = i;
+		while (run_end < pairs.end() && run_end->subject == i->subject)
+			++run_end;
+		if (run_end - i < MIN_VECTOR_HITS) {
+			i = run_end;
+			continue;
+		}
+		auto end = std::remove_if(i, run_end, [q, w, window](const Pair& p) {
+			const Letter* query = query_seqs::data_->data(q[p.query]) - w;
+			const sequence clipped = Util::Sequence::clip(query, window, w);
+			return clipped.data() != query || (int)clipped.length() != window;
+		});
+		if (end - i < MIN_VECTOR_HITS) {
+			i = run_end;
+			continue;
+		}
+		if (!batched) {
+			out.assign(hits.data_size(), -1);
+			query_windows.resize(N * stride);
+			batched = true;
+		}
+		const Letter* subject = ref_seqs::data_->data(s[i->subject]) - w;
+		while (i < end) {
+			const int n = (int)std::min(ptrdiff_t(N), end - i);
+			for (int k = 0; k < n; ++k) {
+				const Letter* query = query_seqs::data_->data(q[i[k].query]) - w;
+				Letter* dst = &query_windows[k * stride];
+				for (int l = 0; l < window; ++l)
+					dst[l] = letter_mask(query[l]);
+				query_ptr[k] = dst;
+			}
+			DP::window_ungapped_best(subject, query_ptr, n, window, scores);
+			// The 8 bit kernel saturates, these scores are recomputed with the scalar kernel.
+			for (int k = 0; k < n; ++k)
+				out[i[k].hit] = scores[k] >= UCHAR_MAX ? ungapped_window(query_ptr[k], subject, window) : scores[k];
+			i += n;
+		}
+		i = run_end;
+	}
+	return batched;
+}
+
+#endif
+
+template<typename _fp>
 struct Stage2 {
 
 	Stage2(const Packed_loc* q, const Packed_loc* s, Statistics& stat, Trace_pt_buffer::Iterator& out, unsigned sid, const Context& context):
@@ -124,11 +236,18 @@ struct Stage2 {
 		stat.inc(Statistics::TENTATIVE_MATCHES1, hits.data_size());
 		const uint32_t query_count = (uint32_t)hits.size();
 		const Packed_loc* q_begin = q + query_begin, * s_begin = s + subject_begin;
+		thread_local vector<int> batch_scores;
+		bool batch = false;
+#ifdef __SSE4_1__
+		if (context.symmetric_matrix && config.ungapped_evalue != 0.0 && hits.data_size() >= (size_t)MIN_VECTOR_HITS)
+			batch = batch_window_scores(hits, q_begin, s_begin, batch_scores);
+#endif
 		for (uint32_t i = 0; i < query_count; ++i) {
 			const uint32_t* r1 = hits.begin(i), * r2 = hits.end(i);
 			if (r2 == r1)
 				continue;
-			search_query_offset(q_begin[i], s_begin, r1, r2, stat, out, sid, context);
+			const int* scores = batch && r2 - r1 < MIN_VECTOR_HITS ? batch_scores.data() + (r1 - hits.begin(0)) : nullptr;
+			search_query_offset<_fp>(q_begin[i], s_begin, r1, r2, stat, out, sid, context, scores);
 		}
 	}
 
@@ -140,9 +259,11 @@ struct Stage2 {
 
 };
 
-typedef vector<Finger_print, Util::Memory::AlignmentAllocator<Finger_print, 16>> Container;
+template<typename _fp>
+using Container = vector<_fp, Util::Memory::AlignmentAllocator<_fp, alignof(_fp)>>;
 
-static void load_fps(const Packed_loc* p, size_t n, Container& v, const Sequence_set& seqs)
+template<typename _fp>
+static void load_fps(const Packed_loc* p, size_t n, Container<_fp>& v, const Sequence_set& seqs)
 {
 	v.clear();
 	v.reserve(n);
@@ -151,14 +272,29 @@ static void load_fps(const Packed_loc* p, size_t n, Container& v, const Sequence
 		v.emplace_back(seqs.data(*p));
 }
 
-void stage1(const Packed_loc* q, size_t nq, const Packed_loc* s, size_t ns, Statistics& stats, Trace_pt_buffer::Iterator& out, const unsigned sid, const Context& context)
+template<typename _fp>
+static void stage1(const Packed_loc* q, size_t nq, const Packed_loc* s, size_t ns, Statistics& stats, Trace_pt_buffer::Iterator& out, const unsigned sid, const Context& context)
 {
-	thread_local Container vq, vs;
+	thread_local Container<_fp> vq, vs;
 	stats.inc(Statistics::SEED_HITS, nq * ns);
 	load_fps(q, nq, vq, *query_seqs::data_);
 	load_fps(s, ns, vs, *ref_seqs::data_);
-	Stage2 callback(q, s, stats, out, sid, context);
+	Stage2<_fp> callback(q, s, stats, out, sid, context);
 	all_vs_all(vq.data(), vq.size(), vs.data(), vs.size(), config.tile_size, callback);
 }
 
+void stage1(const Packed_loc* q, size_t nq, const Packed_loc* s, size_t ns, Statistics& stats, Trace_pt_buffer::Iterator& out, const unsigned sid, const Context& context)
+{
+	switch (config.fingerprint_width) {
+	case 32:
+		stage1<Byte_finger_print_32>(q, nq, s, ns, stats, out, sid, context);
+		break;
+	case 64:
+		stage1<Byte_finger_print_64>(q, nq, s, ns, stats, out, sid, context);
+		break;
+	default:
+		stage1<Byte_finger_print_48>(q, nq, s, ns, stats, out, sid, context);
+	}
+}
+
 }}
\ No newline at end of file
@@ -121,6 +121,8 @@ struct hit
 		uint32_t query_id, seed_offset;
 		s.varint = true;
 		s >> query_id >> seed_offset;
+		if (config.compress_temp > 0)
+			return read_delta(s, it, query_id, seed_offset);
 		Packed_loc subject_loc;
 		size_t count = 0;
 		uint32_t x;
@@ -143,6 +145,20 @@ struct hit
 			++count;
 		}
 	}
+	// Record written with --compress-temp: hit count, then zigzag encoded subject offset deltas and scores as varints.
+	template<typename _it>
+	static size_t read_delta(Deserializer& s, _it it, uint32_t query_id, uint32_t seed_offset) {
+		uint32_t count, score;
+		uint64_t subject = 0, delta;
+		s >> count;
+		for (uint32_t i = 0; i < count; ++i) {
+			read_varint64(s, delta);
+			s >> score;
+			subject = zigzag_undelta(subject, delta);
+			*it = { query_id, Packed_loc(subject), seed_offset, (uint16_t)score };
+		}
+		return count;
+	}
 } PACKED_ATTRIBUTE;
 
 #pragma pack()
@@ -150,7 +166,7 @@ struct hit
 struct Trace_pt_buffer : public Async_buffer<hit>
 {
 	Trace_pt_buffer(size_t input_size, const string &tmpdir, unsigned query_bins):
-		Async_buffer<hit>(input_size, tmpdir, query_bins)
+		Async_buffer<hit>(input_size, tmpdir, query_bins, size_t(config.trace_pt_membuf * 1e9))
 	{}
 	static Trace_pt_buffer *instance;
 };
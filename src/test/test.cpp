@@ -22,15 +22,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <limits.h>
 #include <string.h>
+#include <stdio.h>
 #include <numeric>
 #include <algorithm>
 #include <iomanip>
 #include "../util/io/temp_file.h"
 #include "../util/io/text_input_file.h"
+#include "../util/text_buffer.h"
 #include "test.h"
 #include "../util/sequence/sequence.h"
 #include "../util/log_stream.h"
 #include "../data/reference.h"
+#include "../data/seed_frequency.h"
 #include "../basic/statistics.h"
 #include "../run/workflow.h"
 #include "../util/util.h"
@@ -44,15 +47,15 @@ using std::cout;
 
 namespace Test {
 
-size_t run_testcase(size_t i, DatabaseFile &db, TextInputFile &query_file, size_t max_width, bool bootstrap, bool log, bool to_cout) {
-	vector<string> args = tokenize(test_cases[i].command_line, " ");
+size_t run_testcase(const char *desc, const char *command_line, uint64_t ref_hash, DatabaseFile &db, DatabaseFile &buffered_db, TextInputFile &query_file, size_t max_width, bool bootstrap, bool log, bool to_cout) {
+	vector<string> args = tokenize(command_line, " ");
 	args.emplace(args.begin(), "diamond");
 	if (log)
 		args.push_back("--log");
 	config = Config((int)args.size(), charp_array(args.begin(), args.end()).data(), false);
 	statistics.reset();
 	Workflow::Search::Options opt;
-	opt.db = &db;
+	opt.db = config.no_mmap ? &buffered_db : &db;
 	query_file.rewind();
 	opt.query_file = &query_file;
 
@@ -77,8 +80,8 @@ size_t run_testcase(size_t i, DatabaseFile &db, TextInputFile &query_file, size_
 	if (bootstrap)
 		cout << "0x" << std::hex << hash << ',' << endl;
 	else {
-		const bool passed = hash == ref_hashes[i];
-		cout << std::setw(max_width) << std::left << test_cases[i].desc << " [ ";
+		const bool passed = hash == ref_hash;
+		cout << std::setw(max_width) << std::left << desc << " [ ";
 		set_color(passed ? Color::GREEN : Color::RED);
 		cout << (passed ? "Passed" : "Failed");
 		reset_color();
@@ -88,31 +91,110 @@ size_t run_testcase(size_t i, DatabaseFile &db, TextInputFile &query_file, size_
 	return 0;
 }
 
+// Builds the database db_file_name from the input file using the given makedb options. The taxonomy files are passed
+// to makedb unless their names are empty.
+void make_test_db(const char *makedb_args, const string &db_file_name, TextInputFile &input_file, const string &taxon_map, const string &taxon_nodes, bool log) {
+	vector<string> args = tokenize(makedb_args, " ");
+	args.erase(std::remove(args.begin(), args.end(), string()), args.end());
+	args.insert(args.begin(), { "diamond", "makedb" });
+	if (!taxon_map.empty())
+		args.insert(args.end(), { "--taxonmap", taxon_map, "--taxonnodes", taxon_nodes });
+	args.push_back(log ? "--log" : "--quiet");
+	config = Config((int)args.size(), charp_array(args.begin(), args.end()).data(), false);
+	config.database = db_file_name;
+	input_file.rewind();
+	make_db(nullptr, &input_file);
+}
+
+static void write_seqs(size_t begin, size_t end, OutputFile &out) {
+	for (size_t i = begin; i < end; ++i)
+		Util::Sequence::format(sequence::from_string(seqs[i].second.c_str()), seqs[i].first.c_str(), nullptr, out, "fasta", amino_acid_traits);
+}
+
+// The taxonomy of the test dataset has two superkingdoms (taxon ids 2 and 3) with one species each (4 and 5). The
+// sequences are mapped to the species in turn, every third sequence is not mapped.
+static void write_taxonomy(OutputFile &taxon_map, OutputFile &taxon_nodes) {
+	TextBuffer buf;
+	buf << "accession\taccession.version\ttaxid\tgi\n";
+	for (size_t i = 0; i < seqs.size(); ++i)
+		if (i % 3 != 2)
+			buf << seqs[i].first << '\t' << seqs[i].first << '\t' << (i % 3 == 0 ? 4u : 5u) << "\t0\n";
+	taxon_map.write(buf.get_begin(), buf.size());
+	buf.clear();
+	buf << "1\t|\t1\t|\tno rank\n"
+		<< "2\t|\t1\t|\tsuperkingdom\n"
+		<< "3\t|\t1\t|\tsuperkingdom\n"
+		<< "4\t|\t2\t|\tspecies\n"
+		<< "5\t|\t3\t|\tspecies\n";
+	taxon_nodes.write(buf.get_begin(), buf.size());
+}
+
 int run() {
 	const bool bootstrap = config.bootstrap, log = config.debug_log, to_cout = config.output_file == "stdout";
 	task_timer timer("Generating test dataset");
-	TempFile proteins;
-	for (size_t i = 0; i < seqs.size(); ++i)
-		Util::Sequence::format(sequence::from_string(seqs[i].second.c_str()), seqs[i].first.c_str(), nullptr, proteins, "fasta", amino_acid_traits);
-	TextInputFile query_file(proteins);
+	TempFile proteins, first_half, second_half;
+	write_seqs(0, seqs.size(), proteins);
+	write_seqs(0, seqs.size() / 2, first_half);
+	write_seqs(seqs.size() / 2, seqs.size(), second_half);
+	TextInputFile query_file(proteins), first_half_file(first_half), second_half_file(second_half);
+	TempFile taxon_map(false), taxon_nodes(false);
+	const string taxon_map_name = taxon_map.file_name(), taxon_nodes_name = taxon_nodes.file_name();
+	write_taxonomy(taxon_map, taxon_nodes);
+	taxon_map.close();
+	taxon_nodes.close();
 	timer.finish();
 
 	config.command = Config::makedb;
-	TempFile *db_file;
-	make_db(&db_file, &query_file);
-	DatabaseFile db(*db_file);
-
-	const size_t n = test_cases.size(),
-		max_width = std::accumulate(test_cases.begin(), test_cases.end(), (size_t)0, [](size_t l, const TestCase& t) { return std::max(l, strlen(t.desc)); });
+	TempFile db_file(false);
+	const string db_file_name = db_file.file_name();
+	db_file.close();
+	config.database = db_file_name;
+	make_db(nullptr, &query_file);
+	// The test cases load the reference through the memory mapping of the database file, test cases run with
+	// --no-mmap use buffered reads.
+	DatabaseFile db(db_file_name);
+	config.no_mmap = true;
+	DatabaseFile buffered_db(db_file_name);
+
+	const size_t n = test_cases.size() + db_test_cases.size(),
+		max_width = std::max(std::accumulate(test_cases.begin(), test_cases.end(), (size_t)0, [](size_t l, const TestCase& t) { return std::max(l, strlen(t.desc)); }),
+			std::accumulate(db_test_cases.begin(), db_test_cases.end(), (size_t)0, [](size_t l, const DbTestCase& t) { return std::max(l, strlen(t.desc)); }));
 	size_t passed = 0;
-	for (size_t i = 0; i < n; ++i)
-		passed += run_testcase(i, db, query_file, max_width, bootstrap, log, to_cout);
+	for (size_t i = 0; i < test_cases.size(); ++i)
+		passed += run_testcase(test_cases[i].desc, test_cases[i].command_line, ref_hashes[i], db, buffered_db, query_file, max_width, bootstrap, log, to_cout);
+
+	// The database test cases build their own database from the test sequences.
+	if (bootstrap)
+		cout << endl;
+	for (size_t i = 0; i < db_test_cases.size(); ++i) {
+		TempFile variant_file(false);
+		const string variant_file_name = variant_file.file_name();
+		variant_file.close();
+		const string map_name = db_test_cases[i].taxonomy ? taxon_map_name : string(),
+			nodes_name = db_test_cases[i].taxonomy ? taxon_nodes_name : string();
+		if (db_test_cases[i].append_args) {
+			make_test_db(db_test_cases[i].makedb_args, variant_file_name, first_half_file, map_name, nodes_name, log);
+			make_test_db(db_test_cases[i].append_args, variant_file_name, second_half_file, map_name, nodes_name, log);
+		}
+		else
+			make_test_db(db_test_cases[i].makedb_args, variant_file_name, query_file, map_name, nodes_name, log);
+		DatabaseFile variant_db(variant_file_name);
+		passed += run_testcase(db_test_cases[i].desc, db_test_cases[i].command_line, db_ref_hashes[i], variant_db, variant_db, query_file, max_width, bootstrap, log, to_cout);
+		variant_db.close();
+		remove(variant_file_name.c_str());
+	}
 
 	cout << endl << "#Test cases passed: " << passed << '/' << n << endl; // << endl;
 	
 	query_file.close_and_delete();
+	first_half_file.close_and_delete();
+	second_half_file.close_and_delete();
+	remove(taxon_map_name.c_str());
+	remove(taxon_nodes_name.c_str());
 	db.close();
-	delete db_file;
+	buffered_db.close();
+	remove(db_file_name.c_str());
+	remove(SeedFrequency::file_name(db_file_name).c_str());
 	return passed == n ? 0 : 1;
 }
 
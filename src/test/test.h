@@ -32,11 +32,23 @@ struct TestCase {
 	const char *desc, *command_line;
 };
 
+// A search against a database built by makedb with the given options instead of the default database. If append_args
+// is set, the database is built from the first half of the test sequences and the second half is appended to it by a
+// makedb run with these options. If taxonomy is set, makedb maps the test sequences to the taxonomy of the test
+// dataset (--taxonmap, --taxonnodes).
+struct DbTestCase {
+	const char *desc, *makedb_args, *append_args;
+	bool taxonomy;
+	const char *command_line;
+};
+
 std::vector<Letter> generate_random_seq(size_t length, std::minstd_rand0 &rand_engine);
 std::vector<Letter> simulate_homolog(const sequence &seq, double id, std::minstd_rand0 &random_engine);
 
 extern const std::vector<std::pair<std::string, std::string>> seqs;
 extern const std::vector<TestCase> test_cases;
 extern const std::vector<uint64_t> ref_hashes;
+extern const std::vector<DbTestCase> db_test_cases;
+extern const std::vector<uint64_t> db_ref_hashes;
 
 }
\ No newline at end of file
@@ -28,12 +28,21 @@ const vector<TestCase> test_cases = {
 { "blastp (default)", "blastp -p1" },
 { "blastp (multithreaded)", "blastp -p4" },
 { "blastp (blocked)", "blastp -c1 -b0.00002 -p4" },
+{ "blastp (compress-temp 1)", "blastp -c1 -b0.00002 -p4 --compress-temp 1" },
+{ "blastp (compress-temp 2)", "blastp -c1 -b0.00002 -p4 --compress-temp 2" },
+{ "blastp (trace-pt-membuf)", "blastp -c1 -b0.00002 -p4 --trace-pt-membuf 1" },
 { "blastp (more-sensitive)", "blastp --more-sensitive -c1 -p4" },
+{ "blastp (fingerprint-width 32)", "blastp --more-sensitive -c1 -p4 --fingerprint-width 32" },
+{ "blastp (fingerprint-width 64)", "blastp --more-sensitive -c1 -p4 --fingerprint-width 64" },
+{ "blastp (fingerprint-width auto)", "blastp --more-sensitive -c1 -p4 --fingerprint-width auto" },
 { "blastp (very-sensitive)", "blastp --very-sensitive -c1 -p4" },
 { "blastp (ultra-sensitive)", "blastp --ultra-sensitive -c1 -p4" },
 { "blastp (max-hsps)", "blastp --more-sensitive -c1 -p4 --max-hsps 0" },
 { "blastp (target-parallel)", "blastp --more-sensitive -c1 -p4 --query-parallel-limit 1" },
 { "blastp (query-indexed)", "blastp --more-sensitive -c1 -p4 --algo 1" },
+{ "blastp (subject-indexed)", "blastp --more-sensitive -c1 -p4 --algo 2" },
+{ "blastp (minimizer-window)", "blastp --more-sensitive -c1 -p4 --minimizer-window 4" },
+{ "blastp (global-freq)", "blastp --more-sensitive -c1 -b0.00002 -p4 --freq-sd 5 --global-freq" },
 { "blastp (comp-based-stats)", "blastp --more-sensitive -c1 -p4 --comp-based-stats 0" },
 { "blastp (target seqs)", "blastp -k3 -c1 -p4" },
 { "blastp (top)", "blastp --top 10 -p4"},
@@ -41,19 +50,29 @@ const vector<TestCase> test_cases = {
 { "blastp (blosum50)", "blastp --matrix blosum50 -p4"},
 { "blastp (pairwise format)", "blastp -c1 -f0 -p4" },
 { "blastp (XML format)", "blastp -c1 -f xml -p4" },
-{ "blastp (PAF format)", "blastp -c1 -f paf -p1" }
+{ "blastp (PAF format)", "blastp -c1 -f paf -p1" },
+{ "blastp (no-mmap)", "blastp -c1 -p4 --no-mmap" }
 };
 
 const vector<uint64_t> ref_hashes = {
 0x84c4115983e586c,
 0x84c4115983e586c,
 0x2def78441b4c3a7a,
+0x2def78441b4c3a7a,
+0x2def78441b4c3a7a,
+0x2def78441b4c3a7a,
+0x2b645cd10219017f,
+0xaabb64b34adf0cb3,
+0x54cb92b200deefcf,
 0x2b645cd10219017f,
 0x25885e48f1ac3e89,
 0xbd269d535e4f069c,
 0xc4f255d1db2c9320,
 0x2b645cd10219017f,
 0x1e18a06b7e01a95d,
+0x2b645cd10219017f,
+0x912d31b3a77398c2,
+0x8de11fc71131ca0e,
 0x17513888b40a4ecf,
 0xb05cbb3d3b7c740a,
 0x8ac0057c68f8c239,
@@ -62,6 +81,21 @@ const vector<uint64_t> ref_hashes = {
 0x1797ca2c968d754,
 0x618de50df33df0a1,
 0xbf42ad46448d9ab8,
+0x84c4115983e586c,
+};
+
+const vector<DbTestCase> db_test_cases = {
+{ "makedb (packed)", "--packed", nullptr, false, "blastp -c1 -p4" },
+{ "makedb (append)", "", "--append", false, "blastp -c1 -p4" },
+{ "makedb (group-by-taxon)", "--group-by-taxon", nullptr, true, "blastp -c1 -p4 --taxonlist 2" },
+{ "makedb (unmasked blocks)", "--masking 0", nullptr, false, "blastp -c1 -b0.00002 -p4 --masking 0" }
+};
+
+const vector<uint64_t> db_ref_hashes = {
+0x84c4115983e586c,
+0x84c4115983e586c,
+0x8cb52f61d610886a,
+0xb2ece9e593618ea0,
 };
 
 }
\ No newline at end of file
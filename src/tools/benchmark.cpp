@@ -56,7 +56,11 @@ void benchmark_hamming(const sequence &s1, const sequence &s2) {
 
 	Byte_finger_print_48 f1(s1.data()), f2 (s2.data());
 	for (size_t i = 0; i < n; ++i) {
+#ifdef __AVX512BW__
+		f1.r = _mm512_xor_si512(f1.r, f2.r);
+#else
 		f1.r1 = _mm_xor_si128(f1.r1, f1.r2);
+#endif
 		volatile unsigned y = f1.match(f2);
 	}
 	cout << "SSE hamming distance:\t\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 48) * 1000 << " ps/Cell" << endl;
@@ -132,6 +136,21 @@ void benchmark_ungapped_sse(const sequence &s1, const sequence &s2) {
 		cout << "AVX2 ungapped extend:\t\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 32 * 64) * 1000 << " ps/Cell" << endl;
 	}
 #endif
+#if ARCH_ID == 3
+	{
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+		const Letter* targets[64];
+		int out[64];
+		for (int i = 0; i < 64; ++i)
+			targets[i] = s2.data();
+
+		for (size_t i = 0; i < n; ++i) {
+			::DP::ARCH_AVX512::window_ungapped(s1.data(), targets, 64, 64, out);
+		}
+		cout << "AVX-512 ungapped extend:\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 64 * 64) * 1000 << " ps/Cell" << endl;
+	}
+#endif
 }
 #endif
 
@@ -150,7 +169,7 @@ void benchmark_transpose() {
 	}
 	cout << "Matrix transpose 16x16 bytes:\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 256) * 1000 << " ps/Letter" << endl;
 
-#if ARCH_ID == 2
+#if ARCH_ID >= 2
 	{
 		static signed char in[32 * 32], out[32 * 32];
 		signed char* v[32];
@@ -165,6 +184,21 @@ void benchmark_transpose() {
 		cout << "Matrix transpose 32x32 bytes:\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 32 * 32) * 1000 << " ps/Letter" << endl;
 	}
 #endif
+#if ARCH_ID == 3
+	{
+		alignas(64) static signed char in[64 * 64], out[64 * 64];
+		signed char* v[64];
+		for (int i = 0; i < 64; ++i)
+			v[i] = &in[i * 64];
+
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		for (size_t i = 0; i < n; ++i) {
+			transpose((const signed char**)v, 64, out, __m512i());
+			in[0] = out[0];
+		}
+		cout << "Matrix transpose 64x64 bytes:\t" << (double)duration_cast<std::chrono::nanoseconds>(high_resolution_clock::now() - t1).count() / (n * 64 * 64) * 1000 << " ps/Letter" << endl;
+	}
+#endif
 }
 #endif
 
@@ -23,12 +23,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include <utility>
 #include <algorithm>
+#include <vector>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
 #include "../../basic/config.h"
 #include "../util.h"
 #include "radix_cluster.h"
 #include "../data_structures/hash_table.h"
 #include "../data_structures/double_array.h"
 #include "../math/integer.h"
+#include "../memory/alignment.h"
 
 struct RelPtr
 {
@@ -45,21 +50,88 @@ struct RelPtr
 	unsigned r, s;
 };
 
+// Scratch memory of one join thread, reused for all its seed partitions. The buffers only grow, so once they have
+// reached the size of the largest partition, a join neither allocates memory nor faults in new pages. Large buffers
+// are aligned to 2 MB so that they can be backed by huge pages, which reduces the TLB misses of the scattered
+// accesses in clustering and table lookups.
+struct JoinScratch
+{
+	enum { BUF_R, BUF_S, TABLE, BUFFERS };
+
+	JoinScratch()
+	{
+		for (int i = 0; i < BUFFERS; ++i)
+			buf_[i] = { nullptr, 0 };
+	}
+
+	~JoinScratch()
+	{
+		for (int i = 0; i < BUFFERS; ++i)
+			Util::Memory::aligned_free(buf_[i].data);
+	}
+
+	template<typename _t>
+	_t* get(int buffer, size_t n)
+	{
+		Buffer &b = buf_[buffer];
+		const size_t size = n * sizeof(_t);
+		if (size > b.size) {
+			Util::Memory::aligned_free(b.data);
+			b.size = std::max(size, b.size + b.size / 2);
+			b.data = Util::Memory::aligned_malloc(b.size, b.size >= HUGE_PAGE ? HUGE_PAGE : 64);
+#ifdef MADV_HUGEPAGE
+			if (b.size >= HUGE_PAGE)
+				madvise(b.data, b.size, MADV_HUGEPAGE);
+#endif
+		}
+		return (_t*)b.data;
+	}
+
+	// Radix histograms of the R and S relations for one level of recursion.
+	unsigned* histograms(unsigned level, unsigned clusters)
+	{
+		if (hst_.size() <= level)
+			hst_.resize(level + 1);
+		if (hst_[level].size() < 2 * clusters)
+			hst_[level].resize(2 * clusters);
+		return hst_[level].data();
+	}
+
+private:
+
+	static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+	struct Buffer {
+		void *data;
+		size_t size;
+	};
+
+	Buffer buf_[BUFFERS];
+	std::vector<std::vector<unsigned>> hst_;
+
+};
+
+// Distance in elements of the table prefetches ahead of the build and probe loops.
+static const size_t JOIN_PREFETCH = 16;
+
 template<typename _t>
 void hash_table_join(
 	const Relation<_t> &R,
 	const Relation<_t> &S,
 	unsigned shift,
 	DoubleArray<typename _t::Value> &dst_r,
-	DoubleArray<typename _t::Value> &dst_s)
+	DoubleArray<typename _t::Value> &dst_s,
+	JoinScratch &scratch)
 {
 	typedef HashTable<unsigned, RelPtr, ExtractBits<uint32_t>> Table;
 	
 	uint32_t N = (uint32_t)next_power_of_2(R.n * config.join_ht_factor);
-	Table table(N, ExtractBits<uint32_t>(N, shift));
+	Table table(N, ExtractBits<uint32_t>(N, shift), scratch.get<typename Table::Entry>(JoinScratch::TABLE, N));
 	typename Table::Entry *p;
 
 	for (_t *i = R.data; i < R.end(); ++i) {
+		if (i + JOIN_PREFETCH < R.end())
+			table.prefetch(i[JOIN_PREFETCH].key);
 		p = table.insert(i->key);
 		++p->r;
 		i->key = unsigned(p - table.data());
@@ -67,6 +139,8 @@ void hash_table_join(
 
 	_t *hit_s = S.data;
 	for (_t *i = S.data; i < S.end(); ++i) {
+		if (i + JOIN_PREFETCH < S.end())
+			table.prefetch(i[JOIN_PREFETCH].key);
 		if ((p = table.find_entry(i->key))) {
 			++p->s;
 			hit_s->value = i->value;
@@ -114,11 +188,13 @@ void table_join(
 	unsigned total_bits,
 	unsigned shift,
 	DoubleArray<typename _t::Value> &dst_r,
-	DoubleArray<typename _t::Value> &dst_s)
+	DoubleArray<typename _t::Value> &dst_s,
+	JoinScratch &scratch)
 {
 	const unsigned keys = 1 << (total_bits - shift);
 	ExtractBits<uint32_t> key(keys, shift);
-	RelPtr *table = (RelPtr*)calloc(keys, sizeof(RelPtr));
+	RelPtr *table = scratch.get<RelPtr>(JoinScratch::TABLE, keys);
+	memset((void*)table, 0, keys * sizeof(RelPtr));
 	RelPtr *p;
 
 	for (_t *i = R.data; i < R.end(); ++i)
@@ -126,6 +202,10 @@ void table_join(
 
 	_t *hit_s = S.data;
 	for (_t *i = S.data; i < S.end(); ++i) {
+#ifdef __GNUC__
+		if (i + JOIN_PREFETCH < S.end())
+			__builtin_prefetch(&table[key(i[JOIN_PREFETCH].key)]);
+#endif
 		if ((p = &table[key(i->key)])->r) {
 			++p->s;
 			std::copy(i, i + 1, hit_s++);
@@ -162,8 +242,17 @@ void table_join(
 		dst_s[p->s] = i->value;
 		p->s += sizeof(typename _t::Value);
 	}
+}
 
-	free(table);
+// Number of radix bits for splitting a relation of n entries, enough to bring the clusters to the split size in one
+// pass if config.radix_bits allows it. Smaller fan-outs keep the number of concurrently written clusters within the
+// TLB reach.
+static inline unsigned join_radix_bits(size_t n, unsigned key_bits)
+{
+	unsigned bits = 1;
+	while (bits < config.radix_bits && (n >> bits) >= config.join_split_size)
+		++bits;
+	return std::min(bits, key_bits);
 }
 
 template<typename _t>
@@ -174,8 +263,10 @@ void hash_join(
 	_t *dst_s,
 	DoubleArray<typename _t::Value> &out_r,
 	DoubleArray<typename _t::Value> &out_s,
+	JoinScratch &scratch,
 	unsigned total_bits = 32,
-	unsigned shift = 0)
+	unsigned shift = 0,
+	unsigned level = 0)
 {
 	if (R.n == 0 || S.n == 0)
 		return;
@@ -183,35 +274,30 @@ void hash_join(
 	if (R.n < config.join_split_size || key_bits < config.join_split_key_len) {
 		DoubleArray<typename _t::Value> tmp_r((void*)dst_r), tmp_s((void*)dst_s);
 		if (next_power_of_2(R.n * config.join_ht_factor) < 1llu << key_bits)
-			hash_table_join(R, S, shift, tmp_r, tmp_s);
+			hash_table_join(R, S, shift, tmp_r, tmp_s, scratch);
 		else
-			table_join(R, S, total_bits, shift, tmp_r, tmp_s);
+			table_join(R, S, total_bits, shift, tmp_r, tmp_s, scratch);
 		out_r.append(tmp_r);
 		out_s.append(tmp_s);
 	}
 	else {
-		const unsigned clusters = 1 << config.radix_bits;
-		unsigned *hstR = new unsigned[clusters], *hstS = new unsigned[clusters];
-		radix_cluster<_t, typename _t::GetKey>(R, shift, dst_r, hstR);
-		radix_cluster<_t, typename _t::GetKey>(S, shift, dst_s, hstS);
+		const unsigned bits = join_radix_bits(R.n, key_bits), clusters = 1 << bits;
+		unsigned *hstR = scratch.histograms(level, clusters), *hstS = hstR + clusters;
+		radix_cluster<_t, typename _t::GetKey>(R, shift, dst_r, hstR, bits);
+		radix_cluster<_t, typename _t::GetKey>(S, shift, dst_s, hstS, bits);
 
-		shift += config.radix_bits;
-		hash_join(Relation<_t>(dst_r, hstR[0]), Relation<_t>(dst_s, hstS[0]), R.data, S.data, out_r, out_s, total_bits, shift);
+		shift += bits;
+		hash_join(Relation<_t>(dst_r, hstR[0]), Relation<_t>(dst_s, hstS[0]), R.data, S.data, out_r, out_s, scratch, total_bits, shift, level + 1);
 		for (unsigned i = 1; i < clusters; ++i)
-			hash_join(Relation<_t>(dst_r + hstR[i - 1], hstR[i] - hstR[i - 1]), Relation<_t>(dst_s + hstS[i - 1], hstS[i] - hstS[i - 1]), R.data + hstR[i - 1], S.data + hstS[i - 1], out_r, out_s, total_bits, shift);
-
-		delete[] hstR;
-		delete[] hstS;
+			hash_join(Relation<_t>(dst_r + hstR[i - 1], hstR[i] - hstR[i - 1]), Relation<_t>(dst_s + hstS[i - 1], hstS[i] - hstS[i - 1]), R.data + hstR[i - 1], S.data + hstS[i - 1], out_r, out_s, scratch, total_bits, shift, level + 1);
 	}
 }
 
 template<typename _t>
-std::pair<DoubleArray<typename _t::Value>, DoubleArray<typename _t::Value>> hash_join(Relation<_t> R, Relation<_t> S, unsigned total_bits = 32) {
-	_t *buf_r = (_t*)malloc(sizeof(_t) * R.n), *buf_s = (_t*)malloc(sizeof(_t) * S.n);
+std::pair<DoubleArray<typename _t::Value>, DoubleArray<typename _t::Value>> hash_join(Relation<_t> R, Relation<_t> S, JoinScratch &scratch, unsigned total_bits = 32) {
+	_t *buf_r = scratch.get<_t>(JoinScratch::BUF_R, R.n), *buf_s = scratch.get<_t>(JoinScratch::BUF_S, S.n);
 	DoubleArray<typename _t::Value> out_r((void*)R.data), out_s((void*)S.data);
-	hash_join(R, S, buf_r, buf_s, out_r, out_s, total_bits);
-	free(buf_r);
-	free(buf_s);
+	hash_join(R, S, buf_r, buf_s, out_r, out_s, scratch, total_bits);
 	return { out_r, out_s };
 }
 
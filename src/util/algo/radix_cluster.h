@@ -64,11 +64,11 @@ struct ExtractBits
 };
 
 template<typename _t, typename _get_key>
-void radix_cluster(const Relation<_t> &in, unsigned shift, _t *out, unsigned *hst)
+void radix_cluster(const Relation<_t> &in, unsigned shift, _t *out, unsigned *hst, unsigned bits)
 {
 	typedef typename _t::Key Key;
 	static const size_t BUF_SIZE = 8;
-	const unsigned clusters = 1 << config.radix_bits;
+	const unsigned clusters = 1 << bits;
 	ExtractBits<Key> radix(clusters, shift);
 
 	memset(hst, 0, clusters*sizeof(unsigned));
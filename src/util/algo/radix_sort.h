@@ -39,7 +39,7 @@ void radix_sort(_t* begin, _t* end, uint32_t max_key, size_t threads) {
 			parallel_radix_cluster<_t, _get_key>(Relation<_t>(in, n), i * config.radix_bits, out, threads);
 		else {
 			unsigned *hst = new unsigned[1 << config.radix_bits];
-			radix_cluster< _t, _get_key>(Relation<_t>(in, n), i * config.radix_bits, out, hst);
+			radix_cluster< _t, _get_key>(Relation<_t>(in, n), i * config.radix_bits, out, hst, config.radix_bits);
 			delete[] hst;
 		}
 
@@ -47,39 +47,78 @@ inline void write_varint(uint32_t x, _out &out)
 	}
 }
 
+template<typename _out>
+inline void write_varint64(uint64_t x, _out &out)
+{
+	if (x < 1llu << 32)
+		write_varint((uint32_t)x, out);
+	else {
+		out.write((uint8_t)32);
+		out.write(big_endian_byteswap(x));
+	}
+}
+
+// Zigzag encoding of the signed difference x - prev, so that small differences in both directions give short varints.
+static inline uint64_t zigzag_delta(uint64_t prev, uint64_t x)
+{
+	const int64_t d = int64_t(x - prev);
+	return uint64_t(d) << 1 ^ uint64_t(d >> 63);
+}
+
+static inline uint64_t zigzag_undelta(uint64_t prev, uint64_t z)
+{
+	return prev + (uint64_t(z >> 1) ^ (uint64_t)-int64_t(z & 1));
+}
+
 template<typename _buf>
-void read_varint(_buf &buf, uint32_t &dst)
+uint64_t read_varint_tail(_buf &buf, uint8_t b0)
 {
-	uint8_t b0, b1;
+	uint8_t b1;
 	uint16_t b2;
 	uint32_t b3;
-	buf.read(b0);
+	uint64_t b4;
 	int c = ctz((uint32_t)b0);
 	switch (c) {
 	case 0:
-		dst = b0 >> 1;
-		return;
+		return b0 >> 1;
 	case 1:
 		buf.read(b1);
-		dst = (uint32_t(b1) << 6) | (uint32_t(b0) >> 2);
-		return;
+		return (uint32_t(b1) << 6) | (uint32_t(b0) >> 2);
 	case 2:
 		buf.read(b2);
 		b2 = big_endian_byteswap(b2);
-		dst = (uint32_t(b2) << 5) | (uint32_t(b0) >> 3);
-		return;
+		return (uint32_t(b2) << 5) | (uint32_t(b0) >> 3);
 	case 3:
 		buf.read(b1);
 		buf.read(b2);
 		b2 = big_endian_byteswap(b2);
-		dst = (uint32_t(b2) << 12) | (uint32_t(b1) << 4) | (uint32_t(b0) >> 4);
-		return;
+		return (uint32_t(b2) << 12) | (uint32_t(b1) << 4) | (uint32_t(b0) >> 4);
 	case 4:
 		buf.read(b3);
 		b3 = big_endian_byteswap(b3);
-		dst = (b3 << 3) | (uint32_t(b0) >> 5);
-		return;
+		return (b3 << 3) | (uint32_t(b0) >> 5);
+	case 5:
+		buf.read(b4);
+		return big_endian_byteswap(b4);
 	default:
 		throw std::runtime_error("Format error: Invalid varint encoding.");
 	}
-}
\ No newline at end of file
+}
+
+template<typename _buf>
+void read_varint(_buf &buf, uint32_t &dst)
+{
+	uint8_t b0;
+	buf.read(b0);
+	if (ctz((uint32_t)b0) > 4)
+		throw std::runtime_error("Format error: Invalid varint encoding.");
+	dst = (uint32_t)read_varint_tail(buf, b0);
+}
+
+template<typename _buf>
+void read_varint64(_buf &buf, uint64_t &dst)
+{
+	uint8_t b0;
+	buf.read(b0);
+	dst = read_varint_tail(buf, b0);
+}
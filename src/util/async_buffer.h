@@ -28,6 +28,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <tuple>
 #include <iterator>
 #include <atomic>
+#include <mutex>
+#include <zlib.h>
 #include "../basic/config.h"
 #include "io/temp_file.h"
 #include "io/input_file.h"
@@ -42,19 +44,22 @@ struct Async_buffer
 
 	typedef std::vector<_t> Vector;
 
-	Async_buffer(size_t input_count, const std::string &tmpdir, unsigned bins) :
+	Async_buffer(size_t input_count, const std::string &tmpdir, unsigned bins, size_t mem_budget = 0) :
 		bins_(bins),
 		bin_size_((input_count + bins_ - 1) / bins_),
 		input_count_(input_count),
 		bins_processed_(0),
-		total_disk_size_(0)
+		total_disk_size_(0),
+		groups_(std::max(std::min(config.threads_, (unsigned)MAX_GROUPS), 1u)),
+		tmp_file_(groups_ * bins),
+		mem_budget_(mem_budget),
+		mem_size_(0),
+		mem_segments_(bins)
 	{
-		log_stream << "Async_buffer() " << input_count << ',' << bin_size_ << std::endl;
+		log_stream << "Async_buffer() " << input_count << ',' << bin_size_ << ',' << groups_ << ',' << mem_budget << std::endl;
 		count_ = new std::atomic_size_t[bins];
-		for (unsigned i = 0; i < bins; ++i) {
-			tmp_file_.push_back(new AsyncFile());
+		for (unsigned i = 0; i < bins; ++i)
 			count_[i] = (size_t)0;
-		}
 	}
 
 	~Async_buffer() {
@@ -75,12 +80,12 @@ struct Async_buffer
 	{
 		Iterator(Async_buffer &parent, size_t thread_num) :
 			buffer_(parent.bins()),
+			segments_(parent.bins()),
 			count_(parent.bins(), 0),
+			out_(parent.bins(), nullptr),
+			group_(unsigned(thread_num % parent.groups_)),
 			parent_(parent)
 		{
-			for (unsigned i = 0; i < parent.bins_; ++i) {
-				out_.push_back(&parent.tmp_file_[i]);
-			}
 		}
 		void push(unsigned id, const char *data, size_t size, size_t count)
 		{
@@ -93,7 +98,19 @@ struct Async_buffer
 		}
 		void flush(unsigned bin)
 		{
-			out_[bin]->write(buffer_[bin].data(), buffer_[bin].size());
+			if (buffer_[bin].empty())
+				return;
+			if (parent_.reserve_memory(buffer_[bin].size())) {
+				segments_[bin].push_back(std::move(buffer_[bin]));
+				buffer_[bin] = std::vector<char>();
+				return;
+			}
+			if (out_[bin] == nullptr)
+				out_[bin] = &parent_.file(group_, bin);
+			if (config.compress_temp > 1)
+				write_block(bin);
+			else
+				out_[bin]->write(buffer_[bin].data(), buffer_[bin].size());
 			buffer_[bin].clear();
 		}
 		~Iterator()
@@ -102,12 +119,33 @@ struct Async_buffer
 				flush(bin);
 				parent_.count_[bin] += count_[bin];
 			}
+			std::lock_guard<std::mutex> lock(parent_.mem_mtx_);
+			for (unsigned bin = 0; bin < parent_.bins_; ++bin)
+				for (std::vector<char>& v : segments_[bin])
+					parent_.mem_segments_[bin].push_back(std::move(v));
 		}
 	private:
+		// Deflates the buffer as an independent block prefixed by its raw and compressed sizes.
+		void write_block(unsigned bin)
+		{
+			if (buffer_[bin].empty())
+				return;
+			uLongf compressed_size = compressBound((uLong)buffer_[bin].size());
+			block_.resize(2 * sizeof(uint32_t) + compressed_size);
+			if (compress2((Bytef*)block_.data() + 2 * sizeof(uint32_t), &compressed_size, (const Bytef*)buffer_[bin].data(), (uLong)buffer_[bin].size(), Z_BEST_SPEED) != Z_OK)
+				throw std::runtime_error("Error compressing temporary file.");
+			const uint32_t sizes[2] = { (uint32_t)buffer_[bin].size(), (uint32_t)compressed_size };
+			memcpy(block_.data(), sizes, sizeof(sizes));
+			out_[bin]->write(block_.data(), 2 * sizeof(uint32_t) + compressed_size);
+		}
 		enum { buffer_size = 65536 };
 		std::vector<std::vector<char>> buffer_;
+		// Flushed buffers kept in memory, handed to the parent when the iterator is destroyed.
+		std::vector<std::vector<std::vector<char>>> segments_;
+		std::vector<char> block_;
 		std::vector<size_t> count_;
 		std::vector<AsyncFile*> out_;
+		const unsigned group_;
 		Async_buffer &parent_;
 	};
 
@@ -120,10 +158,10 @@ struct Async_buffer
 			data_next_ = nullptr;
 			return;
 		}
-		size_t size = count_[bins_processed_], end = bins_processed_ + 1, current_size, disk_size = tmp_file_[bins_processed_].tell();
+		size_t size = count_[bins_processed_], end = bins_processed_ + 1, current_size, disk_size = this->disk_size(bins_processed_);
 		while (end < bins_ && (size + (current_size = count_[end])) * sizeof(_t) < max_size) {
 			size += current_size;
-			disk_size += tmp_file_[end].tell();
+			disk_size += this->disk_size(end);
 			++end;
 		}
 		log_stream << "Async_buffer.load() " << size << "(" << (double)size * sizeof(_t) / (1 << 30) << " GB, " << (double)disk_size / (1 << 30) << " GB on disk)" << std::endl;
@@ -154,23 +192,98 @@ struct Async_buffer
 
 private:
 
+	// Temporary files are shared by groups of threads, so that writes contend less for a file's lock while the
+	// number of open files stays within a small multiple of the bin count. The file buffer is split among the
+	// groups, so the buffered data per bin is the same as with a single file. A group's file for a bin is created
+	// on its first write.
+	AsyncFile& file(unsigned group, size_t bin)
+	{
+		std::lock_guard<std::mutex> lock(file_mtx_);
+		AsyncFile*& f = tmp_file_.get(group * bins_ + bin);
+		if (f == nullptr)
+			f = new AsyncFile(std::max(config.file_buffer_size / groups_, (size_t)MIN_FILE_BUFFER));
+		return *f;
+	}
+
+	size_t disk_size(size_t bin)
+	{
+		size_t n = 0;
+		for (unsigned g = 0; g < groups_; ++g)
+			if (tmp_file_.get(g * bins_ + bin) != nullptr)
+				n += tmp_file_[g * bins_ + bin].tell();
+		return n;
+	}
+
 	void load_bin(std::vector<_t> &out, size_t bin)
 	{
-		InputFile f(tmp_file_[bin], InputStreamBuffer::ASYNC);
 		auto it = std::back_inserter(out);
 		size_t count = 0;
-		try {
-			while(true) count += _t::read(f, it);
-		} catch(EndOfStream&) {}
-		f.close_and_delete();
+		for (unsigned g = 0; g < groups_; ++g)
+			if (tmp_file_.get(g * bins_ + bin) != nullptr)
+				count += load_file(tmp_file_[g * bins_ + bin], it);
+		for (const std::vector<char>& v : mem_segments_[bin]) {
+			Deserializer d(v.data(), v.data() + v.size());
+			while (d.data() < v.data() + v.size())
+				count += _t::read(d, it);
+			mem_size_ -= v.size();
+		}
+		std::vector<std::vector<char>>().swap(mem_segments_[bin]);
 		if (count != count_[bin])
-			throw std::runtime_error("Mismatching hit count / possibly corrupted temporary file: " + f.file_name);
+			throw std::runtime_error("Mismatching hit count / possibly corrupted temporary file.");
+	}
+
+	template<typename _it>
+	static size_t load_file(AsyncFile& tmp_file, _it it)
+	{
+		InputFile f(tmp_file, InputStreamBuffer::ASYNC);
+		size_t count = 0;
+		if (config.compress_temp > 1) {
+			std::vector<char> block, raw;
+			uint32_t sizes[2];
+			while (f.read(sizes, 2) == 2) {
+				block.resize(sizes[1]);
+				raw.resize(sizes[0]);
+				uLongf raw_size = sizes[0];
+				if (f.read(block.data(), sizes[1]) != sizes[1]
+					|| uncompress((Bytef*)raw.data(), &raw_size, (const Bytef*)block.data(), sizes[1]) != Z_OK
+					|| raw_size != sizes[0])
+					throw std::runtime_error("Error decompressing temporary file: " + f.file_name);
+				Deserializer d(raw.data(), raw.data() + raw.size());
+				while (d.data() < raw.data() + raw.size())
+					count += _t::read(d, it);
+			}
+		}
+		else {
+			try {
+				while (true) count += _t::read(f, it);
+			}
+			catch (EndOfStream&) {}
+		}
+		f.close_and_delete();
+		return count;
+	}
+
+	bool reserve_memory(size_t n)
+	{
+		if (mem_budget_ == 0)
+			return false;
+		if (mem_size_.fetch_add(n) + n <= mem_budget_)
+			return true;
+		mem_size_ -= n;
+		return false;
 	}
 
 	const unsigned bins_;
 	const size_t bin_size_, input_count_;
 	size_t bins_processed_, total_disk_size_;
+	enum { MAX_GROUPS = 4, MIN_FILE_BUFFER = 1 << 20 };
+	const unsigned groups_;
 	PtrVector<AsyncFile> tmp_file_;
+	std::mutex file_mtx_;
+	const size_t mem_budget_;
+	std::atomic_size_t mem_size_;
+	std::vector<std::vector<std::vector<char>>> mem_segments_;
+	std::mutex mem_mtx_;
 	std::atomic_size_t *count_;
 	std::pair<size_t, size_t> input_range_next_;
 	std::vector<_t>* data_next_;
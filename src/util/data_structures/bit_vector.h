@@ -41,6 +41,20 @@ struct BitVector {
 		return data_[i >> 6] & (uint64_t(1) << (i & 63));
 	}
 
+	// Returns the index of the first set bit >= i, or a value >= the size of the vector if there is none.
+	size_t next_set(size_t i) const {
+		size_t w = i >> 6;
+		if (w >= data_.size())
+			return data_.size() * 64;
+		uint64_t x = data_[w] & (~uint64_t(0) << (i & 63));
+		while (x == 0) {
+			if (++w == data_.size())
+				return data_.size() * 64;
+			x = data_[w];
+		}
+		return w * 64 + ctz(x);
+	}
+
 	BitVector& operator|=(const BitVector& v) {
 		for (size_t i = 0; i < data_.size(); ++i)
 			data_[i] |= v.data_[i];
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdexcept>
 #include <stdlib.h>
+#include <string.h>
 
 template<typename _K, typename _V, typename _HashFunction>
 struct HashTable : private _HashFunction
@@ -38,13 +39,25 @@ struct HashTable : private _HashFunction
 	HashTable(size_t size, const _HashFunction &hash) :
 		_HashFunction(hash),
 		table((Entry*)calloc(size, sizeof(Entry))),
-		size_(size)
+		size_(size),
+		own_(true)
 	{
 	}
 
+	// Uses the given memory for the table, which needs room for size entries and is not freed.
+	HashTable(size_t size, const _HashFunction &hash, void *buffer) :
+		_HashFunction(hash),
+		table((Entry*)buffer),
+		size_(size),
+		own_(false)
+	{
+		memset((void*)table, 0, size * sizeof(Entry));
+	}
+
 	~HashTable()
 	{
-		free(table);
+		if (own_)
+			free(table);
 	}
 
 	_V& operator[](_K key)
@@ -89,6 +102,13 @@ struct HashTable : private _HashFunction
 		return table;
 	}
 
+	void prefetch(_K key) const
+	{
+#ifdef __GNUC__
+		__builtin_prefetch(&table[_HashFunction::operator()(key)]);
+#endif
+	}
+
 private:
 
 	Entry* get_entry(_K key, bool stat=false)
@@ -158,6 +178,7 @@ private:
 
 	Entry *table;
 	size_t size_;
+	bool own_;
 
 };
 
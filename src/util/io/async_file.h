@@ -25,8 +25,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 struct AsyncFile : public TempFile {
 
-	AsyncFile():
-		TempFile()
+	AsyncFile(size_t buffer_size = 0):
+		TempFile(true, buffer_size)
 	{}
 
 	template<typename _t>
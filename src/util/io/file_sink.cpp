@@ -46,7 +46,9 @@ FileSink::FileSink(const string &file_name, const char *mode, bool async, size_t
 #ifdef _MSC_VER
 	f_ = file_name.length() == 0 ? stdout : fopen(file_name.c_str(), mode);
 #else
-	int fd_ = file_name.length() == 0 ? 1 : POSIX_OPEN(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	// Update modes ("r+") open an existing file without truncating it.
+	const int flags = mode[0] == 'r' ? O_RDWR : O_WRONLY | O_CREAT | O_TRUNC;
+	int fd_ = file_name.length() == 0 ? 1 : POSIX_OPEN(file_name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 	if (fd_ < 0) {
 		perror(0);
 		throw File_open_exception(file_name_);
@@ -0,0 +1,113 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <stdexcept>
+#ifdef _MSC_VER
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#include "mapped_file.h"
+
+using std::string;
+using std::runtime_error;
+
+#ifdef _MSC_VER
+
+MappedFile::MappedFile(const string &file_name):
+	data_(nullptr),
+	size_(0),
+	file_(INVALID_HANDLE_VALUE),
+	mapping_(nullptr)
+{
+	file_ = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_ == INVALID_HANDLE_VALUE)
+		throw runtime_error("Error opening file " + file_name);
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size)) {
+		CloseHandle(file_);
+		throw runtime_error("Error getting size of file " + file_name);
+	}
+	size_ = (size_t)size.QuadPart;
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_ == NULL) {
+		CloseHandle(file_);
+		throw runtime_error("Error mapping file " + file_name);
+	}
+	data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (data_ == nullptr) {
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+		throw runtime_error("Error mapping file " + file_name);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(data_);
+	CloseHandle(mapping_);
+	CloseHandle(file_);
+}
+
+void MappedFile::advise_sequential(size_t offset, size_t n) const
+{
+}
+
+#else
+
+MappedFile::MappedFile(const string &file_name):
+	data_(nullptr),
+	size_(0)
+{
+	int fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw runtime_error("Error opening file " + file_name);
+	struct stat buf;
+	if (fstat(fd, &buf) < 0 || !S_ISREG(buf.st_mode)) {
+		::close(fd);
+		throw runtime_error("Error calling stat on file " + file_name);
+	}
+	size_ = (size_t)buf.st_size;
+	void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		throw runtime_error("Error mapping file " + file_name);
+	data_ = (const char*)p;
+}
+
+MappedFile::~MappedFile()
+{
+	munmap((void*)data_, size_);
+}
+
+void MappedFile::advise_sequential(size_t offset, size_t n) const
+{
+	static const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t begin = offset / page_size * page_size;
+	madvise((void*)(data_ + begin), offset + n - begin, MADV_SEQUENTIAL);
+	madvise((void*)(data_ + begin), offset + n - begin, MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,57 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include <string>
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file. The pages are shared with the page cache,
+// so that several processes reading the same file keep only one copy in memory.
+struct MappedFile
+{
+
+	MappedFile(const std::string &file_name);
+	~MappedFile();
+
+	const char* data(size_t offset = 0) const
+	{
+		return data_ + offset;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	// Hint that the range [offset, offset + n) will be read sequentially.
+	void advise_sequential(size_t offset, size_t n) const;
+
+private:
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char *data_;
+	size_t size_;
+#ifdef _MSC_VER
+	void *file_, *mapping_;
+#endif
+
+};
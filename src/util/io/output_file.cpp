@@ -26,8 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "output_stream_buffer.h"
 #include "compressed_stream.h"
 
-OutputFile::OutputFile(const string &file_name, bool compressed, const char *mode) :
-	Serializer(new OutputStreamBuffer(new FileSink(file_name, mode))),
+OutputFile::OutputFile(const string &file_name, bool compressed, const char *mode, size_t buffer_size) :
+	Serializer(new OutputStreamBuffer(new FileSink(file_name, mode), buffer_size)),
 	file_name_(file_name)
 {
 	if (compressed) {
@@ -37,8 +37,8 @@ OutputFile::OutputFile(const string &file_name, bool compressed, const char *mod
 }
 
 #ifndef _MSC_VER
-OutputFile::OutputFile(pair<string, int> fd, const char *mode):
-	Serializer(new OutputStreamBuffer(new FileSink(fd.first, fd.second, mode))),
+OutputFile::OutputFile(pair<string, int> fd, const char *mode, size_t buffer_size):
+	Serializer(new OutputStreamBuffer(new FileSink(fd.first, fd.second, mode), buffer_size)),
 	file_name_(fd.first)
 {
 }
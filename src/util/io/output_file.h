@@ -31,9 +31,9 @@ using std::pair;
 
 struct OutputFile : public Serializer
 {
-	OutputFile(const string &file_name, bool compressed = false, const char *mode = "wb");
+	OutputFile(const string &file_name, bool compressed = false, const char *mode = "wb", size_t buffer_size = 0);
 #ifndef _MSC_VER
-	OutputFile(pair<string, int> fd, const char *mode);
+	OutputFile(pair<string, int> fd, const char *mode, size_t buffer_size = 0);
 #endif
 
 	void remove();
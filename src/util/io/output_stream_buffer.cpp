@@ -19,14 +19,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "../../basic/config.h"
 #include "output_stream_buffer.h"
 
-OutputStreamBuffer::OutputStreamBuffer(StreamEntity* prev):
+OutputStreamBuffer::OutputStreamBuffer(StreamEntity* prev, size_t buffer_size):
 	StreamEntity(prev),
-	buf_(new char[config.file_buffer_size])
+	buffer_size_(buffer_size ? buffer_size : config.file_buffer_size),
+	buf_(new char[buffer_size_])
 {}
 
 pair<char*, char*> OutputStreamBuffer::write_buffer()
 {
-	return std::make_pair(buf_.get(), buf_.get() + config.file_buffer_size);
+	return std::make_pair(buf_.get(), buf_.get() + buffer_size_);
 }
 
 void OutputStreamBuffer::flush(size_t count)
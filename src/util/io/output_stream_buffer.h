@@ -25,7 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 struct OutputStreamBuffer : public StreamEntity
 {
-	OutputStreamBuffer(StreamEntity* prev);
+	OutputStreamBuffer(StreamEntity* prev, size_t buffer_size = 0);
 	virtual pair<char*, char*> write_buffer();
 	virtual void flush(size_t count);
 	virtual void seek(size_t pos);
@@ -33,6 +33,7 @@ struct OutputStreamBuffer : public StreamEntity
 	virtual size_t tell();
 private:
 
+	const size_t buffer_size_;
 	std::unique_ptr<char[]> buf_;
 };
 
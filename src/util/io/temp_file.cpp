@@ -78,11 +78,11 @@ pair<string, int> TempFile::init(bool unlink)
 #endif
 }
 
-TempFile::TempFile(bool unlink):
+TempFile::TempFile(bool unlink, size_t buffer_size):
 #ifdef _MSC_VER
-	OutputFile(init(unlink), false, "w+b")
+	OutputFile(init(unlink), false, "w+b", buffer_size)
 #else
-	OutputFile(init(unlink), "w+b")
+	OutputFile(init(unlink), "w+b", buffer_size)
 #endif
 {
 }
@@ -0,0 +1,84 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#include <string.h>
+#include "packed.h"
+
+namespace Util { namespace Sequence { namespace DISPATCH_ARCH {
+
+static inline void unpack_group(const uint8_t *src, Letter *dst)
+{
+	uint64_t x = 0;
+	memcpy(&x, src, PACKED_GROUP_BYTES);
+	x = big_endian_byteswap(x);
+	for (int i = 0; i < PACKED_GROUP_LETTERS; ++i) {
+		dst[i] = Letter(x & LETTER_MASK);
+		x >>= PACKED_BITS;
+	}
+}
+
+#ifdef __SSSE3__
+
+// Gathers the two bytes holding each 5-bit code into a 16 bit lane, moves the code to the top
+// 5 bits of the lane by multiplication with a per-lane power of two and shifts it back down.
+static inline __m128i unpack_groups2(__m128i in)
+{
+	const __m128i shuffle0 = _mm_setr_epi8(0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5),
+		shuffle1 = _mm_setr_epi8(5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10),
+		mul = _mm_setr_epi16(1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8);
+	const __m128i g0 = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in, shuffle0), mul), 11),
+		g1 = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in, shuffle1), mul), 11);
+	return _mm_packus_epi16(g0, g1);
+}
+
+#endif
+
+#ifdef __AVX2__
+
+static inline __m256i unpack_groups4(const uint8_t *src)
+{
+	const __m256i shuffle0 = _mm256_setr_epi8(0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5, 0, 1, 0, 1, 1, 2, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5),
+		shuffle1 = _mm256_setr_epi8(5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10, 5, 6, 5, 6, 6, 7, 6, 7, 7, 8, 8, 9, 8, 9, 9, 10),
+		mul = _mm256_setr_epi16(1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8, 1 << 11, 1 << 6, 1 << 9, 1 << 4, 1 << 7, 1 << 10, 1 << 5, 1 << 8);
+	const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)src)), _mm_loadu_si128((const __m128i*)(src + 2 * PACKED_GROUP_BYTES)), 1);
+	const __m256i g0 = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(in, shuffle0), mul), 11),
+		g1 = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(in, shuffle1), mul), 11);
+	return _mm256_packus_epi16(g0, g1);
+}
+
+#endif
+
+void unpack5(const uint8_t *src, size_t n, Letter *dst)
+{
+	// The vector loads read 16 bytes from the start of each pair of groups, so the last groups
+	// are unpacked by the scalar code.
+#ifdef __AVX2__
+	for (; n >= 6; n -= 4, src += 4 * PACKED_GROUP_BYTES, dst += 4 * PACKED_GROUP_LETTERS)
+		_mm256_storeu_si256((__m256i*)dst, unpack_groups4(src));
+#endif
+#ifdef __SSSE3__
+	for (; n >= 4; n -= 2, src += 2 * PACKED_GROUP_BYTES, dst += 2 * PACKED_GROUP_LETTERS)
+		_mm_storeu_si128((__m128i*)dst, unpack_groups2(_mm_loadu_si128((const __m128i*)src)));
+#endif
+	for (; n > 0; --n, src += PACKED_GROUP_BYTES, dst += PACKED_GROUP_LETTERS)
+		unpack_group(src, dst);
+}
+
+}}}
@@ -0,0 +1,110 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include "../simd.h"
+#include "../../basic/value.h"
+#include "../io/serializer.h"
+
+// 5-bit packed letter encoding. Groups of 8 letters are stored in 5 bytes, least significant
+// bits first. Letter codes are stored as is, the delimiter is DELIMITER_LETTER. Mask bits
+// are not retained.
+
+namespace Util { namespace Sequence {
+
+enum { PACKED_BITS = 5, PACKED_GROUP_LETTERS = 8, PACKED_GROUP_BYTES = 5 };
+
+// Unpacks the letters of n groups into dst (8*n letters).
+DECL_DISPATCH(void, unpack5, (const uint8_t *src, size_t n, Letter *dst))
+
+struct PackedWriter
+{
+
+	PackedWriter(Serializer &out):
+		out_(out),
+		buf_(0),
+		n_(0)
+	{}
+
+	void push(Letter l)
+	{
+		buf_ |= uint64_t(l & LETTER_MASK) << (n_ * PACKED_BITS);
+		if (++n_ == PACKED_GROUP_LETTERS) {
+			write_group();
+			buf_ = 0;
+			n_ = 0;
+		}
+	}
+
+	void push(const Letter *begin, const Letter *end)
+	{
+		for (const Letter *p = begin; p < end; ++p)
+			push(*p);
+	}
+
+	// Pads the last group with delimiters.
+	void finish()
+	{
+		while (n_ > 0)
+			push(DELIMITER_LETTER);
+	}
+
+private:
+
+	void write_group()
+	{
+		const uint64_t x = big_endian_byteswap(buf_);
+		out_.write((const char*)&x, PACKED_GROUP_BYTES);
+	}
+
+	Serializer &out_;
+	uint64_t buf_;
+	unsigned n_;
+
+};
+
+// Unpacks the letters [begin, end) from a packed stream starting at src.
+inline void unpack_range(const uint8_t *src, uint64_t begin, uint64_t end, Letter *dst)
+{
+	Letter buf[PACKED_GROUP_LETTERS];
+	uint64_t group = begin / PACKED_GROUP_LETTERS;
+	if (begin % PACKED_GROUP_LETTERS) {
+		unpack5(src + group * PACKED_GROUP_BYTES, 1, buf);
+		const uint64_t n = std::min(end - begin, PACKED_GROUP_LETTERS - begin % PACKED_GROUP_LETTERS);
+		std::copy(buf + begin % PACKED_GROUP_LETTERS, buf + begin % PACKED_GROUP_LETTERS + n, dst);
+		dst += n;
+		begin += n;
+		++group;
+	}
+	const uint64_t full = (end - begin) / PACKED_GROUP_LETTERS;
+	unpack5(src + group * PACKED_GROUP_BYTES, full, dst);
+	dst += full * PACKED_GROUP_LETTERS;
+	begin += full * PACKED_GROUP_LETTERS;
+	group += full;
+	if (begin < end) {
+		unpack5(src + group * PACKED_GROUP_BYTES, 1, buf);
+		std::copy(buf, buf + (end - begin), dst);
+	}
+}
+
+}}
@@ -37,6 +37,19 @@ inline void cpuid(int CPUInfo[4], int InfoType) {
 #endif
 #endif
 
+#ifdef __SSE2__
+// Returns the XCR0 register, which tells which register states the OS saves on context switches.
+static inline uint64_t xgetbv() {
+#ifdef _WIN32
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
 namespace SIMD {
 
 int flags = 0;
@@ -58,10 +71,15 @@ Arch init_arch() {
 		flags |= POPCNT;
 	if ((info[2] & (1 << 19)) != 0)
 		flags |= SSE4_1;
+	// AVX-512 additionally requires the OS to save the opmask and upper ZMM register states.
+	const bool os_avx512 = (info[2] & (1 << 27)) != 0 && (xgetbv() & 0xe6) == 0xe6;
 	if (nids >= 7) {
 		cpuid(info, 7);
 		if ((info[1] & (1 << 5)) != 0)
 			flags |= AVX2;
+		// AVX512F, AVX512BW and AVX512VL
+		if (os_avx512 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (info[1] & (1u << 31)) != 0)
+			flags |= AVX512;
 	}
 #endif
 
@@ -81,7 +99,15 @@ Arch init_arch() {
 	if ((flags & AVX2) == 0)
 		throw std::runtime_error("CPU does not support AVX2. Please compile the software from source.");
 #endif
+#ifdef __AVX512BW__
+	if ((flags & AVX512) == 0)
+		throw std::runtime_error("CPU does not support AVX-512. Please compile the software from source.");
+#endif
 
+#ifdef WITH_AVX512
+	if ((flags & SSSE3) && (flags & POPCNT) && (flags & SSE4_1) && (flags & AVX2) && (flags & AVX512))
+		return Arch::AVX512;
+#endif
 	if ((flags & SSSE3) && (flags & POPCNT) && (flags & SSE4_1) && (flags & AVX2))
 		return Arch::AVX2;
 	if ((flags & SSSE3) && (flags & POPCNT) && (flags & SSE4_1))
@@ -105,6 +131,8 @@ std::string features() {
 		r.push_back("sse4.1");
 	if (flags & AVX2)
 		r.push_back("avx2");
+	if (flags & AVX512)
+		r.push_back("avx512bw");
 	return r.empty() ? "None" : join(" ", r);
 }
 
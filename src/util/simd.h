@@ -44,18 +44,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace SIMD {
 
-enum class Arch { None, Generic, SSE4_1, AVX2 };
-enum Flags { SSSE3 = 1, POPCNT = 2, SSE4_1 = 4, AVX2 = 8 };
+enum class Arch { None, Generic, SSE4_1, AVX2, AVX512 };
+enum Flags { SSSE3 = 1, POPCNT = 2, SSE4_1 = 4, AVX2 = 8, AVX512 = 16 };
 Arch arch();
 
+// The AVX-512 tier is only compiled if the build defines WITH_AVX512.
+#ifdef WITH_AVX512
+#define DECL_DISPATCH_AVX512(ret, name, param) namespace ARCH_AVX512 { ret name param; }
+#define DISPATCH_CASE_AVX512(name) case ::SIMD::Arch::AVX512: return ARCH_AVX512::name;
+#else
+#define DECL_DISPATCH_AVX512(ret, name, param)
+#define DISPATCH_CASE_AVX512(name)
+#endif
+
 #ifdef __SSE__
 #define DECL_DISPATCH(ret, name, param) namespace ARCH_GENERIC { ret name param; }\
 namespace ARCH_SSE4_1 { ret name param; }\
 namespace ARCH_AVX2 { ret name param; }\
+DECL_DISPATCH_AVX512(ret, name, param)\
 inline std::function<decltype(ARCH_GENERIC::name)> dispatch_target_##name() {\
 switch(::SIMD::arch()) {\
 case ::SIMD::Arch::SSE4_1: return ARCH_SSE4_1::name;\
 case ::SIMD::Arch::AVX2: return ARCH_AVX2::name;\
+DISPATCH_CASE_AVX512(name)\
 default: return ARCH_GENERIC::name;\
 }}\
 const std::function<decltype(ARCH_GENERIC::name)> name = dispatch_target_##name();
@@ -0,0 +1,68 @@
+/****
+DIAMOND protein aligner
+Copyright (C) 2020 Max Planck Society for the Advancement of Science e.V.
+
+Code developed by Benjamin Buchfink <benjamin.buchfink@tue.mpg.de>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****/
+
+#pragma once
+#include "../simd.h"
+
+// Bit reversal of a 4 bit register index. After the in-lane unpack stages, column c of a group of 16 rows
+// ends up in register bitrev4(c) of that group.
+static constexpr int TRANSPOSE64_BITREV4[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+// Transposes 64 rows of 64 bytes. As for the narrower versions, n < 64 rows are placed at the bottom of the
+// matrix, the rows above are zero.
+static inline void transpose(const signed char** data, size_t n, signed char* out, const __m512i&) {
+	__m512i r[64], t;
+	for (size_t i = 0; i < 64 - n; ++i)
+		r[i] = _mm512_setzero_si512();
+	for (size_t i = 64 - n; i < 64; ++i)
+		r[i] = _mm512_loadu_si512((const void*)*(data++));
+
+	// Transpose the 16x16 blocks within each 128 bit lane of each group of 16 rows.
+	for (int i = 0; i < 64; i += 2) {
+		t = r[i]; r[i] = _mm512_unpacklo_epi8(t, r[i + 1]); r[i + 1] = _mm512_unpackhi_epi8(t, r[i + 1]);
+	}
+	for (int i = 0; i < 64; ++i)
+		if ((i & 2) == 0) {
+			t = r[i]; r[i] = _mm512_unpacklo_epi16(t, r[i + 2]); r[i + 2] = _mm512_unpackhi_epi16(t, r[i + 2]);
+		}
+	for (int i = 0; i < 64; ++i)
+		if ((i & 4) == 0) {
+			t = r[i]; r[i] = _mm512_unpacklo_epi32(t, r[i + 4]); r[i + 4] = _mm512_unpackhi_epi32(t, r[i + 4]);
+		}
+	for (int i = 0; i < 64; ++i)
+		if ((i & 8) == 0) {
+			t = r[i]; r[i] = _mm512_unpacklo_epi64(t, r[i + 8]); r[i + 8] = _mm512_unpackhi_epi64(t, r[i + 8]);
+		}
+
+	// Lane l of register group g now holds rows 16g..16g+15 of column 16l+c. A 4x4 transpose of the lanes
+	// across the groups assembles the output rows.
+	__m512i* ptr = (__m512i*)out;
+	for (int c = 0; c < 16; ++c) {
+		const int k = TRANSPOSE64_BITREV4[c];
+		const __m512i a = _mm512_shuffle_i64x2(r[k], r[16 + k], _MM_SHUFFLE(2, 0, 2, 0)),
+			b = _mm512_shuffle_i64x2(r[k], r[16 + k], _MM_SHUFFLE(3, 1, 3, 1)),
+			c2 = _mm512_shuffle_i64x2(r[32 + k], r[48 + k], _MM_SHUFFLE(2, 0, 2, 0)),
+			d = _mm512_shuffle_i64x2(r[32 + k], r[48 + k], _MM_SHUFFLE(3, 1, 3, 1));
+		_mm512_store_si512(ptr + c, _mm512_shuffle_i64x2(a, c2, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm512_store_si512(ptr + 16 + c, _mm512_shuffle_i64x2(b, d, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm512_store_si512(ptr + 32 + c, _mm512_shuffle_i64x2(a, c2, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm512_store_si512(ptr + 48 + c, _mm512_shuffle_i64x2(b, d, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+}
@@ -47,6 +47,14 @@ bool exists(const std::string &file_name) {
 #endif
 }
 
+bool replace_file(const std::string &old_name, const std::string &new_name) {
+#ifdef _MSC_VER
+	return MoveFileExA(old_name.c_str(), new_name.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(old_name.c_str(), new_name.c_str()) == 0;
+#endif
+}
+
 size_t file_size(const char* name)
 {
 #ifdef WIN32
@@ -150,4 +158,37 @@ double total_ram() {
 		return 0.0;
 	return (double)info.totalram / 1e9;
 #endif
-}
\ No newline at end of file
+}
+
+// Memory in GB that can be allocated without swapping, or 0 if it cannot be determined.
+double available_ram() {
+#if defined(WIN32) || defined(__APPLE__) || defined(__FreeBSD__)
+	return 0.0;
+#else
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f) {
+		char line[256];
+		unsigned long long kb;
+		while (fgets(line, sizeof(line), f))
+			if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) {
+				fclose(f);
+				return kb * 1024 / 1e9;
+			}
+		fclose(f);
+	}
+	struct sysinfo info;
+	if (sysinfo(&info) != 0)
+		return 0.0;
+	return ((double)info.freeram + (double)info.bufferram) * info.mem_unit / 1e9;
+#endif
+}
+
+// Falls back to 1 MB if the size cannot be determined.
+size_t l2_cache_size() {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	const long n = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (n > 0)
+		return (size_t)n;
+#endif
+	return 1 << 20;
+}
@@ -10,6 +10,8 @@ void set_color(Color color, bool err = false);
 void reset_color(bool err = false);
 std::string executable_path();
 bool exists(const std::string &file_name);
+// Renames the file, replacing an existing file of the new name. Returns false on error.
+bool replace_file(const std::string &old_name, const std::string &new_name);
 void auto_append_extension(std::string &str, const char *ext);
 void auto_append_extension_if_exists(std::string &str, const char *ext);
 size_t getCurrentRSS();
@@ -17,6 +19,8 @@ size_t getPeakRSS();
 void log_rss();
 size_t file_size(const char* name);
 double total_ram();
+double available_ram();
+size_t l2_cache_size();
 
 #ifdef _MSC_VER
 #define POPEN _popen
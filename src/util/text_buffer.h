@@ -129,6 +129,12 @@ struct TextBuffer
 		return *this;
 	}
 
+	TextBuffer& write_varint64(uint64_t x)
+	{
+		::write_varint64(x, *this);
+		return *this;
+	}
+
 	size_t size() const
 	{ return ptr_ - data_; }
 